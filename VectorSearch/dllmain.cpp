@@ -1,15 +1,38 @@
 // dllmain.cpp : Defines the entry point for the DLL application.
 #include "pch.h"
 #include <vector>
+// all parallel phases run on the thread pool of the library, so Eigen must not start its own OpenMP threads
+#define EIGEN_DONT_PARALLELIZE
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include <numeric>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <array>
+#include <memory>
+#include <exception>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <immintrin.h>
+#define USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 const int versionMajor = 1;
-const int versionMinor = 7;
-const int versionFix = 2;
+const int versionMinor = 8;
+const int versionFix = 0;
 
 #define METHOD_EXPORTS
 #ifdef METHOD_EXPORTS
@@ -18,12 +41,276 @@ const int versionFix = 2;
 #define EXPORT __declspec(dllimport)
 #endif
 
-const int MASS_RANGE = 5000;                                // Encoding values up to 5000 m/z
-const int MASS_MULTIPLIER = 100;                            // Encoding values with 0.01 precision
-const int ENCODING_SIZE = MASS_RANGE * MASS_MULTIPLIER;     // The total length of an encoding vector
+const int MASS_RANGE = 5000;                                // Encoding values up to 5000 m/z by default
+const int MASS_MULTIPLIER = 100;                            // Encoding values with 0.01 precision by default
+const int ENCODING_SIZE = MASS_RANGE * MASS_MULTIPLIER;     // The default total length of an encoding vector
 const int APPROX_NNZ_PER_ROW = 100;                         // Approximate number of ions assumed
 const int ROUNDING_ACCURACY = 1000;                         // Rounding precision for converting f32 to i32, the exact precision is (int) round(val * 1000.0f)
 const double ONE_OVER_SQRT_PI = 0.39894228040143267793994605993438;
+const char INDEX_FILE_MAGIC[8] = {'C', 'V', 'S', 'I', 'N', 'D', 'E', 'X'};
+const int INDEX_FILE_VERSION = 6;                           // Version of the binary candidate index file format
+const int INDEX_FILE_ALIGNMENT = 64;                        // Alignment (in bytes) of the arrays in the binary candidate index file
+const int MAX_INDEX_SEGMENTS = 16;                          // Number of segments after which a candidate index is compacted
+const int64_t MAX_SEGMENT_NNZ = INT32_MAX;                  // Largest number of ions of a candidate segment or peaks of a chunk of spectra, offsets within them are 32-bit
+const int64_t BUILDER_SEGMENT_NNZ = 1 << 26;                // Number of ions a candidate index builder collects before it encodes them as a new segment
+const uint16_t COLUMN_DELTA_ESCAPE = 0xFFFF;                // Marks a column delta that does not fit into 16 bits, followed by the low and high 16 bits of the column index
+const int TOP_ROWS_HEAP_LIMIT = 128;                        // Largest number of top rows that are selected with a bounded heap instead of a full selection
+const int SCORE_TILE_SIZE = 1 << 18;                        // Number of scores (candidate rows * batch size) a thread computes at once in the dense matrix method
+const int QUERY_WINDOW_SIZE = 1 << 16;                      // Number of spectrum matrix entries (bins * batch size) of an m/z window in the dense matrix method, sized to stay in L2
+const int ROARING_ARRAY_LIMIT = 4096;                       // Largest number of rows of a bitmap index container that is stored as a sorted array, larger containers are stored as bitmaps
+const int ROARING_BITMAP_WORDS = (1 << 16) / 64;            // Number of 64-bit words of a bitmap container, one bit for each of the 2^16 rows of a container
+
+// Compressed row-major view of a candidate matrix, either owned by an Eigen::SparseMatrix or memory mapped from an index file
+template <typename T>
+using CandidateMatrix = Eigen::Map<const Eigen::SparseMatrix<T, Eigen::RowMajor>>;
+
+/// <summary>
+/// A view of a block of consecutive candidates of a candidate matrix. Identical candidates can share a single row of the block.
+/// </summary>
+template <typename T>
+struct CandidateBlock {
+    CandidateMatrix<T> m;                                   // The rows of the block
+    int firstCandidate;                                     // Index of the first candidate of the block
+    const int* rowCandidateOffsets;                         // Offsets (rows + 1) into rowCandidates, NULL if every row is a single candidate
+    const int* rowCandidates;                               // Candidates of every row relative to firstCandidate in ascending order, NULL if every row is a single candidate
+    const uint16_t* columnDeltas;                           // Delta encoded column indices of every row, NULL if the inner index of m is used
+    const int64_t* columnDeltaOffsets;                      // Offsets (rows + 1) into columnDeltas, NULL if the inner index of m is used
+    bool normalize;                                         // If candidate vectors are normalized to sum(elements) = 1
+};
+
+// Views of consecutive blocks of candidates that are searched together, the scores of all blocks are concatenated
+template <typename T>
+using CandidateMatrices = std::vector<CandidateBlock<T>>;
+
+// Search methods that can be used with a candidate index, the order matches CPU_METHODS in VectorSearchAPI.cs
+enum SearchMethod {
+    I32_DV = 0,                                             // Sparse matrix - dense vector multiplication using i32 operations
+    F32_DV = 1,                                             // Sparse matrix - dense vector multiplication using f32 operations
+    I32_DM = 2,                                             // Sparse matrix - dense matrix multiplication using i32 operations
+    F32_DM = 3,                                             // Sparse matrix - dense matrix multiplication using f32 operations
+    I32_SV = 4,                                             // Sparse matrix - sparse vector multiplication using i32 operations
+    F32_SV = 5,                                             // Sparse matrix - sparse vector multiplication using f32 operations
+    I32_SM = 6,                                             // Sparse matrix - sparse matrix multiplication using i32 operations
+    F32_SM = 7,                                             // Sparse matrix - sparse matrix multiplication using f32 operations
+    I32_IV = 8,                                             // Inverted index - sparse vector scoring using i32 operations
+    F32_IV = 9,                                             // Inverted index - sparse vector scoring using f32 operations
+    I32_BM = 10,                                            // Bitmap index - binary spectrum scoring using i32 operations
+    F32_BM = 11                                             // Bitmap index - binary spectrum scoring using f32 operations
+};
+
+// Storage layouts of a candidate index, the layouts can be combined and match INDEX_STORAGE in VectorSearchAPI.cs
+enum IndexStorage {
+    CSR_STORAGE = 0,                                        // Compressed sparse rows with 32-bit column indices and values, supports every search method
+    COMPRESSED_COLUMNS = 1,                                 // Compressed sparse rows with delta encoded 16-bit column indices, supports the dense vector, inverted index and bitmap index methods
+    PATTERN_ONLY = 2                                        // Compressed sparse rows without values, the value of every row is applied to its score, supports the dense vector, inverted index and bitmap index methods
+};
+
+/// <summary>
+/// The geometry of the encoding vectors. Ions and peaks are passed already encoded as bins of massMultiplier bins per m/z, bins from
+/// encodingSize on are discarded.
+/// </summary>
+struct EncodingGeometry {
+    int massMultiplier;                                     // Number of bins per m/z, the encoding precision is 1 / massMultiplier
+    int encodingSize;                                       // The total length of an encoding vector
+};
+
+/// <summary>
+/// The owned arrays of a candidate index segment that is not stored as an Eigen::SparseMatrix.
+/// </summary>
+struct SegmentArrays {
+    std::vector<int> outerIndex;                            // Row offsets (rows + 1) of the segment
+    std::vector<int> innerIndex;                            // Column indices (nnz), empty if the column indices are delta encoded
+    std::vector<int64_t> columnDeltaOffsets;                // Row offsets (rows + 1) into columnDeltas, empty if the column indices are not delta encoded
+    std::vector<uint16_t> columnDeltas;                     // Delta encoded column indices of every row, see encodeCandidateColumns
+    std::vector<float> valuesF32;                           // f32 values (nnz), empty if useInt is true or the segment has no values
+    std::vector<int> valuesI32;                             // i32 values (nnz), empty if useInt is false or the segment has no values
+};
+
+/// <summary>
+/// An immutable compressed row-major block of consecutive candidates of a candidate index.
+/// </summary>
+struct CandidateSegment {
+    int rows;                                               // Number of unique rows in the segment
+    int nnz;                                                // Number of ions in the segment
+    int cols;                                               // Encoding size of the segment, the number of columns of its candidate matrix
+    int candidates;                                         // Number of candidates in the segment, identical candidates share a row
+    int firstCandidate;                                     // Index of the first candidate of the segment
+    Eigen::SparseMatrix<float, Eigen::RowMajor>* mF32;      // The owned f32 candidate matrix, NULL if useInt is true or the segment is memory mapped
+    Eigen::SparseMatrix<int, Eigen::RowMajor>* mI32;        // The owned i32 candidate matrix, NULL if useInt is false or the segment is memory mapped
+    const int* outerIndex;                                  // Row offsets (rows + 1) of the segment
+    const int* innerIndex;                                  // Column indices (nnz) of the segment, NULL if the column indices are delta encoded
+    const float* valuesF32;                                 // f32 values (nnz) of the segment, NULL if useInt is true or the segment has no values
+    const int* valuesI32;                                   // i32 values (nnz) of the segment, NULL if useInt is false or the segment has no values
+    const int* rowCandidateOffsets;                         // Offsets (rows + 1) into rowCandidates, NULL if every row is a single candidate
+    const int* rowCandidates;                               // Candidates (candidates) of every row relative to firstCandidate in ascending order, NULL if every row is a single candidate
+    std::vector<int>* candidateMap;                         // The owned storage of rowCandidateOffsets followed by rowCandidates, NULL if not owned
+    const uint16_t* columnDeltas;                           // Delta encoded column indices of every row, NULL if the column indices are not delta encoded
+    const int64_t* columnDeltaOffsets;                      // Offsets (rows + 1) into columnDeltas, NULL if the column indices are not delta encoded
+    SegmentArrays* arrays;                                  // The owned arrays of a segment that is not stored as a matrix, NULL if not owned
+};
+
+/// <summary>
+/// Reusable buffers for selecting the best rows of a score vector, so that no memory has to be allocated for every spectrum.
+/// </summary>
+template <typename T>
+struct TopRowSelector {
+    std::vector<std::pair<T, int>> top;                     // The selected (score, row) pairs
+    std::vector<int> rows;                                  // The selected rows sorted by descending score and ascending row
+    std::vector<T> scores;                                  // The scores of the selected rows
+    std::vector<int> candidates;                            // Rows considered by nth_element or rows with the k-th best score of the radix selection
+    std::vector<uint32_t> histogram;                        // Histogram of the radix selection of i32 scores
+};
+
+/// <summary>
+/// The ions of a tile of consecutive candidate rows split into m/z windows, so that the rows of the spectrum matrix covered by a window
+/// stay in cache while all ions of the tile in that window are scored.
+/// </summary>
+template <typename T>
+struct WindowedCandidateTile {
+    std::vector<int> windowOffsets;                         // Offsets (number of windows + 1) into rows, columns and values
+    std::vector<int> rows;                                  // The row within the tile of every ion, ascending within every window
+    std::vector<int> columns;                               // The column of every ion
+    std::vector<T> values;                                  // The value of every ion
+};
+
+/// <summary>
+/// A persistent pool of worker threads owned by the library that runs the parallel phases of all functions. Threads are created once
+/// and shared by all calls, the thread calling a function always works on its own call as well.
+/// </summary>
+struct ThreadPool {
+    std::vector<std::thread> workers;                       // The worker threads, one less than the number of threads of the pool
+    std::deque<std::function<void()>> tasks;                // Tasks waiting for a worker
+    std::mutex mutex;                                       // Guards tasks and stop
+    std::condition_variable taskAvailable;                  // Signalled when a task is queued or the pool is stopped
+    bool stop;                                              // If the workers should exit once all tasks are done
+    bool pinThreads;                                        // If every worker is pinned to its own CPU
+};
+
+/// <summary>
+/// The encoding window of a spectrum peak, precomputed once per search since it only depends on the tolerance. Bin currentPeak + k of
+/// a spectrum vector is set to values[width + k] for k in [-width, width] if that is larger than the bin.
+/// </summary>
+template <typename T>
+struct ToleranceKernel {
+    int width;                                              // The encoded tolerance t, every peak covers 2 * width + 1 bins
+    int encodingSize;                                       // Length of the spectrum vector, bins of a window from encodingSize on are skipped
+    std::vector<T> values;                                  // The value of every bin of the window, peakValue of the bin
+};
+
+/// <summary>
+/// A column-major inverted index of a candidate matrix that lists the rows containing every m/z bin, so that only the rows sharing an
+/// ion with a spectrum have to be scored. All ions of a row have the same value, so the value is only stored once per row.
+/// </summary>
+template <typename T>
+struct InvertedCandidateMatrix {
+    std::vector<int64_t> columnOffsets;                     // Offsets (encoding size + 1) into rows
+    std::vector<int> rows;                                  // Rows (nnz) containing every column in ascending order, rows continue from one block to the next
+    std::vector<T> rowValues;                               // The value of every ion of every row
+};
+
+/// <summary>
+/// A container of a bitmap index column that holds the rows of the column that share their upper 16 bits, like the containers of a
+/// Roaring bitmap. Sparse containers store the lower 16 bits of their rows as a sorted array, dense containers as a bitmap of 2^16 bits.
+/// Containers store no offsets, the arrays and bitmaps of a column follow each other in the order of its containers.
+/// </summary>
+struct RoaringContainer {
+    uint16_t key;                                           // Upper 16 bits of the rows of the container
+    uint16_t cardinalityMinusOne;                           // Number of rows of the container - 1, containers with more than ROARING_ARRAY_LIMIT rows are bitmaps
+};
+
+/// <summary>
+/// A bitmap index of a candidate matrix that stores the rows containing every m/z bin as compressed bitmaps, so that binary spectra are
+/// scored by counting the rows of the bitmaps of the covered bins. Arrays need 2 bytes per ion and bitmaps 1 bit per row of their
+/// container, every container additionally needs 4 bytes. The index is smaller than the inverted index with its 4 bytes per ion as long
+/// as its containers hold more than 2 rows on average. All ions of a row have the same value, so the value is only stored once per row.
+/// </summary>
+template <typename T>
+struct BitmapCandidateMatrix {
+    std::vector<int64_t> columnOffsets;                     // Offsets (encoding size + 1) into containers
+    std::vector<int64_t> arrayOffsets;                      // Offsets (encoding size + 1) into arrayRows, the first array of every column
+    std::vector<int64_t> bitmapOffsets;                     // Offsets (encoding size + 1) into bitmapWords, the first bitmap of every column
+    std::vector<RoaringContainer> containers;               // Containers of every column in ascending order of their keys
+    std::vector<uint16_t> arrayRows;                        // Lower 16 bits of the rows of all array containers, ascending within every container
+    std::vector<uint64_t> bitmapWords;                      // ROARING_BITMAP_WORDS words of every bitmap container
+    std::vector<T> rowValues;                               // The value of every ion of every row
+};
+
+/// <summary>
+/// A persistent candidate index holding the candidate matrix, so that it only has to be built once and can be searched many times.
+/// The candidate matrix is stored as a list of segments that are searched together, candidates appended with appendCandidateIndex
+/// are stored in a new segment so that the existing candidates do not have to be rebuilt. Candidates with identical ions are stored
+/// and scored only once per segment.
+/// </summary>
+struct CandidateIndex {
+    int cILength;                                           // Number of candidates in the index
+    int64_t nnz;                                            // Number of stored ions in the index, every segment stores at most MAX_SEGMENT_NNZ ions
+    bool normalize;                                         // If candidate vectors are normalized to sum(elements) = 1
+    bool useInt;                                            // If the candidate matrix uses i32 (true) or f32 (false) values
+    int storage;                                            // The storage layout of every segment, see IndexStorage
+    EncodingGeometry geometry;                              // The encoding geometry of every segment and every search of the index
+    std::vector<CandidateSegment> segments;                 // The segments of the candidate matrix, candidate indices continue from one segment to the next
+    void* mapping;                                          // The memory mapped index file, NULL if the index was created in memory
+    size_t mappingSize;                                     // Size of the memory mapped index file in bytes
+    InvertedCandidateMatrix<float>* invertedF32;            // The inverted f32 candidate matrix, NULL until the index is searched with F32_IV
+    InvertedCandidateMatrix<int>* invertedI32;              // The inverted i32 candidate matrix, NULL until the index is searched with I32_IV
+    BitmapCandidateMatrix<float>* bitmapF32;                // The f32 bitmap index, NULL until the index is searched with F32_BM
+    BitmapCandidateMatrix<int>* bitmapI32;                  // The i32 bitmap index, NULL until the index is searched with I32_BM
+    std::mutex invertedMutex;                               // Guards building the inverted candidate matrix and the bitmap index
+};
+
+/// <summary>
+/// Builds a candidate index from chunks of candidates. Chunks are collected until they contain BUILDER_SEGMENT_NNZ ions and then encoded
+/// as a new segment of the index, so neither all candidates nor a candidate matrix of all candidates have to be held in memory at once.
+/// </summary>
+struct CandidateIndexBuilder {
+    CandidateIndex* index;                                  // The candidate index with the segments encoded so far
+    std::vector<int> pendingValues;                         // Ions of the collected candidates that are not encoded yet
+    std::vector<int64_t> pendingIdx;                        // Offsets of the collected candidates into pendingValues
+};
+
+/// <summary>
+/// Header of the binary candidate index file. The header is followed by one CandidateIndexFileSegment per segment of the index and the
+/// arrays of all segments in the order of the segments. Every array starts at a multiple of INDEX_FILE_ALIGNMENT bytes.
+/// </summary>
+struct CandidateIndexFileHeader {
+    char magic[8];                                          // INDEX_FILE_MAGIC
+    int32_t version;                                        // INDEX_FILE_VERSION
+    int32_t flags;                                          // Bit 0: normalize, bit 1: useInt, bit 3: delta encoded column indices, bit 4: no values
+    int32_t segments;                                       // Number of segments
+    int32_t cols;                                           // Encoding size the index was created with
+    int64_t nnz;                                            // Number of ions of all segments
+    int32_t candidates;                                     // Number of candidates
+    int32_t massMultiplier;                                 // Mass multiplier the index was created with
+    int64_t fileSize;                                       // Total size of the file in bytes
+};
+
+/// <summary>
+/// A segment of the binary candidate index file. The arrays of a segment are the outer index (int32, rows + 1), the inner index (int32, nnz)
+/// or, if column indices are delta encoded, the column delta offsets (int64, rows + 1) and the column deltas (uint16, nrColumnDeltas),
+/// the values (f32 or i32, nnz) unless the index has no values, the row values (f32 or i32, rows) and, if identical candidates share rows,
+/// the row candidate offsets (int32, rows + 1) and the row candidates (int32, candidates).
+/// </summary>
+struct CandidateIndexFileSegment {
+    int32_t rows;                                           // Number of unique rows
+    int32_t nnz;                                            // Number of ions
+    int32_t candidates;                                     // Number of candidates
+    int32_t firstCandidate;                                 // Index of the first candidate
+    int64_t outerIndexOffset;                               // Byte offset of the outer index
+    int64_t innerIndexOffset;                               // Byte offset of the inner index, 0 if column indices are delta encoded
+    int64_t valuesOffset;                                   // Byte offset of the values, 0 if the index has no values
+    int64_t rowValuesOffset;                                // Byte offset of the row values, the value of every ion in a row
+    int64_t rowCandidateOffsetsOffset;                      // Byte offset of the row candidate offsets, 0 if every row is a single candidate
+    int64_t rowCandidatesOffset;                            // Byte offset of the row candidates, 0 if every row is a single candidate
+    int64_t columnDeltaOffsetsOffset;                       // Byte offset of the column delta offsets, 0 if column indices are not delta encoded
+    int64_t columnDeltasOffset;                             // Byte offset of the column deltas, 0 if column indices are not delta encoded
+    int64_t nrColumnDeltas;                                 // Number of column deltas, 0 if column indices are not delta encoded
+};
+
+ThreadPool* globalThreadPool = NULL;                        // The thread pool of the library, created when it is first used
+std::mutex threadPoolMutex;                                 // Guards creating and replacing the thread pool
+thread_local int callThreads = 0;                           // Number of threads the current call of this thread may use, 0 uses all threads of the pool
+thread_local bool insideThreadPool = false;                 // If this thread is currently running a task of the pool
+const EncodingGeometry DEFAULT_GEOMETRY = {MASS_MULTIPLIER, ENCODING_SIZE}; // Encoding geometry of the functions without a candidate index
 
 extern "C" {
     EXPORT int* findTopCandidates(int*, int*, 
@@ -34,6 +321,24 @@ extern "C" {
                                   bool, bool,
                                   int, int);
 
+    EXPORT int* findTopCandidatesWithScores(int*, int*, 
+                                            int*, int*,
+                                            int, int,
+                                            int, int,
+                                            int, float,
+                                            bool, bool,
+                                            int, int,
+                                            float*);
+
+    EXPORT void findTopCandidatesInto(int*, int*, 
+                                      int*, int*,
+                                      int, int,
+                                      int, int,
+                                      int, float,
+                                      bool, bool,
+                                      int, int,
+                                      int*, float*);
+
     EXPORT int* findTopCandidatesInt(int*, int*,
                                      int*, int*,
                                      int, int,
@@ -42,6 +347,24 @@ extern "C" {
                                      bool, bool,
                                      int, int);
 
+    EXPORT int* findTopCandidatesIntWithScores(int*, int*,
+                                               int*, int*,
+                                               int, int,
+                                               int, int,
+                                               int, float,
+                                               bool, bool,
+                                               int, int,
+                                               int*);
+
+    EXPORT void findTopCandidatesIntInto(int*, int*,
+                                         int*, int*,
+                                         int, int,
+                                         int, int,
+                                         int, float,
+                                         bool, bool,
+                                         int, int,
+                                         int*, int*);
+
     EXPORT int* findTopCandidates2(int*, int*,
                                    int*, int*,
                                    int, int,
@@ -50,6 +373,24 @@ extern "C" {
                                    bool, bool,
                                    int, int);
 
+    EXPORT int* findTopCandidates2WithScores(int*, int*,
+                                             int*, int*,
+                                             int, int,
+                                             int, int,
+                                             int, float,
+                                             bool, bool,
+                                             int, int,
+                                             float*);
+
+    EXPORT void findTopCandidates2Into(int*, int*,
+                                       int*, int*,
+                                       int, int,
+                                       int, int,
+                                       int, float,
+                                       bool, bool,
+                                       int, int,
+                                       int*, float*);
+
     EXPORT int* findTopCandidates2Int(int*, int*,
                                       int*, int*,
                                       int, int,
@@ -58,6 +399,24 @@ extern "C" {
                                       bool, bool,
                                       int, int);
 
+    EXPORT int* findTopCandidates2IntWithScores(int*, int*,
+                                                int*, int*,
+                                                int, int,
+                                                int, int,
+                                                int, float,
+                                                bool, bool,
+                                                int, int,
+                                                int*);
+
+    EXPORT void findTopCandidates2IntInto(int*, int*,
+                                          int*, int*,
+                                          int, int,
+                                          int, int,
+                                          int, float,
+                                          bool, bool,
+                                          int, int,
+                                          int*, int*);
+
     EXPORT int* findTopCandidatesBatched(int*, int*,
                                          int*, int*,
                                          int, int,
@@ -67,6 +426,26 @@ extern "C" {
                                          int,
                                          int, int);
 
+    EXPORT int* findTopCandidatesBatchedWithScores(int*, int*,
+                                                   int*, int*,
+                                                   int, int,
+                                                   int, int,
+                                                   int, float,
+                                                   bool, bool,
+                                                   int,
+                                                   int, int,
+                                                   float*);
+
+    EXPORT void findTopCandidatesBatchedInto(int*, int*,
+                                             int*, int*,
+                                             int, int,
+                                             int, int,
+                                             int, float,
+                                             bool, bool,
+                                             int,
+                                             int, int,
+                                             int*, float*);
+
     EXPORT int* findTopCandidatesBatchedInt(int*, int*,
                                             int*, int*,
                                             int, int,
@@ -76,6 +455,26 @@ extern "C" {
                                             int,
                                             int, int);
 
+    EXPORT int* findTopCandidatesBatchedIntWithScores(int*, int*,
+                                                      int*, int*,
+                                                      int, int,
+                                                      int, int,
+                                                      int, float,
+                                                      bool, bool,
+                                                      int,
+                                                      int, int,
+                                                      int*);
+
+    EXPORT void findTopCandidatesBatchedIntInto(int*, int*,
+                                                int*, int*,
+                                                int, int,
+                                                int, int,
+                                                int, float,
+                                                bool, bool,
+                                                int,
+                                                int, int,
+                                                int*, int*);
+
     EXPORT int* findTopCandidatesBatched2(int*, int*,
                                           int*, int*,
                                           int, int,
@@ -85,6 +484,26 @@ extern "C" {
                                           int,
                                           int, int);
 
+    EXPORT int* findTopCandidatesBatched2WithScores(int*, int*,
+                                                    int*, int*,
+                                                    int, int,
+                                                    int, int,
+                                                    int, float,
+                                                    bool, bool,
+                                                    int,
+                                                    int, int,
+                                                    float*);
+
+    EXPORT void findTopCandidatesBatched2Into(int*, int*,
+                                              int*, int*,
+                                              int, int,
+                                              int, int,
+                                              int, float,
+                                              bool, bool,
+                                              int,
+                                              int, int,
+                                              int*, float*);
+
     EXPORT int* findTopCandidatesBatched2Int(int*, int*,
                                              int*, int*,
                                              int, int,
@@ -94,14 +513,267 @@ extern "C" {
                                              int,
                                              int, int);
 
+    EXPORT int* findTopCandidatesBatched2IntWithScores(int*, int*,
+                                                       int*, int*,
+                                                       int, int,
+                                                       int, int,
+                                                       int, float,
+                                                       bool, bool,
+                                                       int,
+                                                       int, int,
+                                                       int*);
+
+    EXPORT void findTopCandidatesBatched2IntInto(int*, int*,
+                                                 int*, int*,
+                                                 int, int,
+                                                 int, int,
+                                                 int, float,
+                                                 bool, bool,
+                                                 int,
+                                                 int, int,
+                                                 int*, int*);
+
+    EXPORT int* findTopCandidatesInverted(int*, int*,
+                                          int*, int*,
+                                          int, int,
+                                          int, int,
+                                          int, float,
+                                          bool, bool,
+                                          int, int);
+
+    EXPORT int* findTopCandidatesInvertedWithScores(int*, int*,
+                                                    int*, int*,
+                                                    int, int,
+                                                    int, int,
+                                                    int, float,
+                                                    bool, bool,
+                                                    int, int,
+                                                    float*);
+
+    EXPORT void findTopCandidatesInvertedInto(int*, int*,
+                                              int*, int*,
+                                              int, int,
+                                              int, int,
+                                              int, float,
+                                              bool, bool,
+                                              int, int,
+                                              int*, float*);
+
+    EXPORT int* findTopCandidatesInvertedInt(int*, int*,
+                                             int*, int*,
+                                             int, int,
+                                             int, int,
+                                             int, float,
+                                             bool, bool,
+                                             int, int);
+
+    EXPORT int* findTopCandidatesInvertedIntWithScores(int*, int*,
+                                                       int*, int*,
+                                                       int, int,
+                                                       int, int,
+                                                       int, float,
+                                                       bool, bool,
+                                                       int, int,
+                                                       int*);
+
+    EXPORT void findTopCandidatesInvertedIntInto(int*, int*,
+                                                 int*, int*,
+                                                 int, int,
+                                                 int, int,
+                                                 int, float,
+                                                 bool, bool,
+                                                 int, int,
+                                                 int*, int*);
+
+    EXPORT CandidateIndex* createCandidateIndex(int*, int*,
+                                                int, int,
+                                                bool, bool,
+                                                int);
+
+    EXPORT CandidateIndex* createCandidateIndexWithStorage(int*, int*,
+                                                           int, int,
+                                                           bool, bool,
+                                                           int,
+                                                           int);
+
+    EXPORT CandidateIndex* createCandidateIndexWithGeometry(int*, int*,
+                                                            int, int,
+                                                            bool, bool,
+                                                            int,
+                                                            int, int,
+                                                            int);
+
+    EXPORT CandidateIndex* createCandidateIndex64(int*, int64_t*,
+                                                  int64_t, int,
+                                                  bool, bool,
+                                                  int,
+                                                  int, int,
+                                                  int);
+
+    EXPORT CandidateIndex* createCandidateIndexFromCSR(int*, int*,
+                                                       int, int,
+                                                       bool, bool,
+                                                       int, int,
+                                                       int);
+
+    EXPORT int appendCandidateIndex(CandidateIndex*,
+                                    int*, int*,
+                                    int, int,
+                                    int);
+
+    EXPORT int appendCandidateIndex64(CandidateIndex*,
+                                      int*, int64_t*,
+                                      int64_t, int,
+                                      int);
+
+    EXPORT CandidateIndexBuilder* beginCandidateIndex(bool, bool,
+                                                      int,
+                                                      int, int);
+
+    EXPORT int appendCandidateIndexChunk(CandidateIndexBuilder*,
+                                         int*, int*,
+                                         int, int,
+                                         int);
+
+    EXPORT CandidateIndex* finishCandidateIndex(CandidateIndexBuilder*, int);
+
+    EXPORT int releaseCandidateIndexBuilder(CandidateIndexBuilder*);
+
+    EXPORT int compactCandidateIndex(CandidateIndex*, int);
+
+    EXPORT int* searchCandidateIndex(CandidateIndex*,
+                                     int*, int*,
+                                     int, int,
+                                     int, float,
+                                     bool,
+                                     int, int,
+                                     int, int);
+
+    EXPORT int* searchCandidateIndexWithScores(CandidateIndex*,
+                                               int*, int*,
+                                               int, int,
+                                               int, float,
+                                               bool,
+                                               int, int,
+                                               int, int,
+                                               void*);
+
+    EXPORT void searchCandidateIndexInto(CandidateIndex*,
+                                         int*, int*,
+                                         int, int,
+                                         int, float,
+                                         bool,
+                                         int, int,
+                                         int, int,
+                                         int*, void*);
+
+    EXPORT int* searchCandidateIndex64(CandidateIndex*,
+                                       int*, int64_t*,
+                                       int64_t, int,
+                                       int, float,
+                                       bool,
+                                       int, int,
+                                       int, int,
+                                       void*);
+
+    EXPORT void searchCandidateIndex64Into(CandidateIndex*,
+                                           int*, int64_t*,
+                                           int64_t, int,
+                                           int, float,
+                                           bool,
+                                           int, int,
+                                           int, int,
+                                           int*, void*);
+
+    EXPORT int saveCandidateIndex(CandidateIndex*, const char*);
+
+    EXPORT CandidateIndex* loadCandidateIndex(const char*);
+
+    EXPORT int releaseCandidateIndex(CandidateIndex*);
+
+    EXPORT int configureThreadPool(int, bool);
+
     EXPORT int releaseMemory(int*);
 }
 
+ThreadPool* threadPool();
+void runThreadPoolWorker(ThreadPool*);
+bool pinThread(std::thread&, int);
+int useThreadPool(int);
+int poolThreads();
+void runParallel(int, const std::function<void(int)>&);
+template <typename F> void parallelFor(int, const F&);
+
+template <typename T> Eigen::SparseMatrix<T, Eigen::RowMajor>* createCandidateMatrix(int*, int*, int, int, bool, int);
+template <typename T> CandidateSegment createCandidateSegment(Eigen::SparseMatrix<T, Eigen::RowMajor>*, int);
+template <typename T> void deduplicateCandidateSegment(CandidateSegment&);
+template <typename T> void convertCandidateSegment(CandidateSegment&, int);
+template <typename T> void finishCandidateSegment(CandidateSegment&, int);
+template <typename T> Eigen::SparseMatrix<T, Eigen::RowMajor>* mergeCandidateSegments(const CandidateIndex*, size_t, size_t);
+std::vector<int>* mergeCandidateMaps(const CandidateIndex*, size_t, size_t);
+std::vector<int> splitOffsetRanges(const int64_t*, int64_t, int, int64_t);
+void appendCandidateSegments(CandidateIndex*, int*, const int64_t*, int64_t, const std::vector<int>&);
+void flushCandidateIndexBuilder(CandidateIndexBuilder*);
+void searchIndexSpectra(CandidateIndex*, int*, int*, int, int, int, float, bool, int, int, int, int*, void*);
+uint64_t hashCandidateRow(const int*, int);
+int largestCandidateIon(const int*, int64_t, int64_t);
+int lowestSetBit(uint64_t);
+int64_t encodeCandidateColumns(const int*, int, uint16_t*);
+void decodeCandidateColumns(const uint16_t*, const uint16_t*, int*);
+template <typename T, bool hasValues> T compressedRowProduct(const uint16_t*, const uint16_t*, const T*, T, const T*);
+template <typename T> T patternRowProduct(const int*, int, T, const T*);
+int bitsetRowMatches(const int*, int, const uint32_t*);
+template <typename T> void multiplyCandidateBlock(const CandidateBlock<T>&, const T*, T*);
+void releaseCandidateSegment(CandidateSegment&);
+template <typename T> CandidateMatrices<T> candidateMatrixView(const Eigen::SparseMatrix<T, Eigen::RowMajor>&, bool);
+template <typename T> CandidateMatrices<T> candidateMatrixView(const CandidateIndex*);
+template <typename T> int candidateMatrixRows(const CandidateMatrices<T>&);
+template <typename T> void expandTopCandidates(const CandidateMatrices<T>&, const int*, const T*, int, int, int*, T*);
+template <typename T, typename Q, typename R> void multiplyCandidateMatrices(const CandidateMatrices<T>&, const Q&, R&);
+template <typename T> const int* candidateRowColumns(const CandidateBlock<T>&, int, std::vector<int>&);
+template <typename T> bool rankedBefore(const std::pair<T, int>&, const std::pair<T, int>&);
+template <typename T> const int* selectTopRows(const T*, const int*, int, int, TopRowSelector<T>&);
+template <typename T> void heapTopRows(const T*, const int*, int, int, TopRowSelector<T>&);
+template <typename T> void radixTopRows(const T*, const int*, int, int, TopRowSelector<T>&);
+template <typename T> void streamTopRows(const T*, int, int, int, std::vector<std::pair<T, int>>&);
+template <typename T> std::vector<std::array<int, 3>> candidateTiles(const CandidateMatrices<T>&, int);
+template <typename T> void expandThreadTopRows(const CandidateMatrices<T>&, std::vector<std::vector<std::vector<std::pair<T, int>>>>&, int, int, TopRowSelector<T>&, int*, T*);
+template <typename T> void splitCandidateTile(const CandidateBlock<T>&, int, int, int, WindowedCandidateTile<T>&);
+template <typename T> InvertedCandidateMatrix<T>* createInvertedCandidateMatrix(const CandidateMatrices<T>&);
+template <typename T> const InvertedCandidateMatrix<T>* invertedCandidateMatrix(CandidateIndex*);
+void releaseInvertedCandidateMatrices(CandidateIndex*);
+template <typename T> BitmapCandidateMatrix<T>* createBitmapCandidateMatrix(const CandidateMatrices<T>&);
+template <typename T> const BitmapCandidateMatrix<T>* bitmapCandidateMatrix(CandidateIndex*);
+template <typename T> void writeIndexArray(std::ofstream&, const T*, int64_t);
+void padIndexFile(std::ofstream&);
+int64_t alignIndexFileOffset(int64_t);
+bool validIndexFileArray(int64_t, int64_t, int64_t, int64_t, size_t);
+bool validIndexFileSegment(const CandidateIndexFileSegment&, const char*, size_t, int64_t, bool, bool);
+void* mapIndexFile(const char*, size_t*);
+void unmapIndexFile(void*, size_t);
+template <typename T> void searchSparseVector(const CandidateMatrices<T>&, const EncodingGeometry&, int*, int*, int, int, int, float, bool, int, int*, T*);
+template <typename T> void searchDenseVector(const CandidateMatrices<T>&, const EncodingGeometry&, int*, int*, int, int, int, float, bool, int, int*, T*);
+template <typename T> void searchBitsetVector(const CandidateMatrices<T>&, const EncodingGeometry&, int*, int*, int, int, int, float, int, int*, T*);
+template <typename T> void searchSparseMatrix(const CandidateMatrices<T>&, const EncodingGeometry&, int*, int*, int, int, int, float, bool, int, int, int*, T*);
+template <typename T> void searchDenseMatrix(const CandidateMatrices<T>&, const EncodingGeometry&, int*, int*, int, int, int, float, bool, int, int, int*, T*);
+template <typename T> void searchInvertedVector(const CandidateMatrices<T>&, const InvertedCandidateMatrix<T>&, const EncodingGeometry&, int*, int*, int, int, int, float, bool, int, int*, T*);
+template <typename T> void searchBitmapVector(const CandidateMatrices<T>&, const BitmapCandidateMatrix<T>&, const EncodingGeometry&, int*, int*, int, int, int, float, int, int*, T*);
+template <typename T> T candidateValue(int, bool);
+template <typename T> T peakValue(int, int, float, bool);
+template <typename T> ToleranceKernel<T> createToleranceKernel(float, bool, const EncodingGeometry&);
+template <typename T> void encodeSpectrum(const ToleranceKernel<T>&, const int*, int, T*, int);
+template <typename T> void encodeSpectrumPeak(const ToleranceKernel<T>&, int, T*);
+template <typename T> void clearSpectrum(const ToleranceKernel<T>&, const int*, int, T*, int);
+template <typename T> void encodeSpectrumBits(const ToleranceKernel<T>&, const int*, int, uint32_t*);
+template <typename T> void clearSpectrumBits(const ToleranceKernel<T>&, const int*, int, uint32_t*);
+template <typename T> void encodeSparseSpectrum(const ToleranceKernel<T>&, const int*, int, std::vector<int>&, std::vector<int>&, std::vector<T>&);
+template <typename T> void encodeSpectrumBatch(const ToleranceKernel<T>&, const int*, const int*, int, int, int, int, std::vector<int>&, std::vector<int>&, std::vector<int>&, std::vector<T>&);
 float squared(float);
 float normpdf(float, float, float);
 
 /// <summary>
 /// A function that calculates the top n candidates for each spectrum (SpM*SpV) using f32 operations. 
+/// Spectra are searched in parallel on the given number of cores.
 /// </summary>
 /// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
 /// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
@@ -115,7 +787,7 @@ float normpdf(float, float, float);
 /// <param name="tolerance">Tolerance for peak matching (float).</param>
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
 /// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
@@ -127,92 +799,64 @@ int* findTopCandidates(int* candidatesValues, int* candidatesIdx,
                        bool normalize, bool gaussianTol,
                        int cores, int verbose) {
 
-    if (n > cILength) {
-        throw std::invalid_argument("Cannot return more hits than number of candidates!");
-    }
-
-    int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
-
-    std::cout << "Running Eigen f32 sparse vector search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
-    std::cout << "Using " << usedCores << " threads in total." << std::endl;
-
-    auto* m = new Eigen::SparseMatrix<float, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
-
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        float val = normalize ? 1.0 / (float) nrNonZero : 1.0;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
-
-    m->makeCompressed();
-
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
-
-    for (int i = 0; i < sILength; ++i) {
-        int startIter = spectraIdx[i];
-        int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
-        auto* v = new Eigen::SparseVector<float, Eigen::ColMajor>(ENCODING_SIZE);
-        v->reserve(APPROX_NNZ_PER_ROW);
-        for (int j = startIter; j < endIter; ++j) {
-            auto currentPeak = spectraValues[j];
-            auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-            auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
-
-            for (int k = minPeak; k <= maxPeak; ++k) {
-                float currentVal = v->coeffRef(k);
-                float newVal = gaussianTol ? normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) : 1.0;
-                v->coeffRef(k) = max(currentVal, newVal);
-            }
-        }
-        
-        auto* spmv = new Eigen::Vector<float, Eigen::Dynamic>(cILength);
-        *spmv = Eigen::Product(*m, *v);
-
-        std::vector<float> colValues;
-        colValues.resize(spmv->size());
-        Eigen::Map<Eigen::Vector<float, Eigen::Dynamic>>(colValues.data(), spmv->size()) = *spmv;
-
-        auto* idx = new int[cILength];
-        std::iota(idx, idx + cILength, 0);
-        std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
-
-        for (int j = 0; j < n; ++j) {
-            result[i * n + j] = idx[j];
-        }
-
-        delete[] idx;
+    return findTopCandidatesWithScores(candidatesValues, candidatesIdx,
+                                       spectraValues, spectraIdx,
+                                       cVLength, cILength,
+                                       sVLength, sILength,
+                                       n, tolerance,
+                                       normalize, gaussianTol,
+                                       cores, verbose,
+                                       NULL);
+}
 
-        spmv->resize(0);
-        v->resize(0);
-        delete spmv;
-        delete v;
-        spmv = NULL;
-        v = NULL;
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*SpV) using f32 operations. 
+/// Spectra are searched in parallel on the given number of cores.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+int* findTopCandidatesWithScores(int* candidatesValues, int* candidatesIdx, 
+                                 int* spectraValues, int* spectraIdx,
+                                 int cVLength, int cILength,
+                                 int sVLength, int sILength,
+                                 int n, float tolerance,
+                                 bool normalize, bool gaussianTol,
+                                 int cores, int verbose,
+                                 float* scores) {
 
-        if (verbose != 0 && (i + 1) % verbose == 0) {
-            std::cout << "Searched " << i + 1 << " spectra in total..." << std::endl;
-        }
-    }
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
 
-    m->resize(0, 0);
-    delete m;
-    m = NULL;
+    findTopCandidatesInto(candidatesValues, candidatesIdx,
+                          spectraValues, spectraIdx,
+                          cVLength, cILength,
+                          sVLength, sILength,
+                          n, tolerance,
+                          normalize, gaussianTol,
+                          cores, verbose,
+                          result.get(), scores);
 
-    return result;
+    return result.release();
 }
 
 /// <summary>
-/// A function that calculates the top n candidates for each spectrum (SpM*SpV) using i32 operations. 
+/// A function that calculates the top n candidates for each spectrum (SpM*SpV) using f32 operations. 
+/// Spectra are searched in parallel on the given number of cores. The indexes are written to a caller-provided array.
 /// </summary>
 /// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
 /// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
@@ -226,109 +870,49 @@ int* findTopCandidates(int* candidatesValues, int* candidatesIdx,
 /// <param name="tolerance">Tolerance for peak matching (float).</param>
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
-/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
-/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
-int* findTopCandidatesInt(int* candidatesValues, int* candidatesIdx,
-                          int* spectraValues, int* spectraIdx,
-                          int cVLength, int cILength,
-                          int sVLength, int sILength,
-                          int n, float tolerance,
-                          bool normalize, bool gaussianTol,
-                          int cores, int verbose) {
+void findTopCandidatesInto(int* candidatesValues, int* candidatesIdx, 
+                           int* spectraValues, int* spectraIdx,
+                           int cVLength, int cILength,
+                           int sVLength, int sILength,
+                           int n, float tolerance,
+                           bool normalize, bool gaussianTol,
+                           int cores, int verbose,
+                           int* result, float* scores) {
 
-    if (n > cILength) {
-        throw std::invalid_argument("Cannot return more hits than number of candidates!");
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
     }
 
-    if (tolerance < 0.01f) {
-        throw std::invalid_argument("Tolerance must not be smaller than 0.01 for i32 operations!");
+    if (n > cILength) {
+        throw std::invalid_argument("Cannot return more hits than number of candidates!");
     }
 
     int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
+    usedCores = useThreadPool(cores);
 
-    std::cout << "Running Eigen i32 sparse vector search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Running Eigen f32 sparse vector search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
     std::cout << "Using " << usedCores << " threads in total." << std::endl;
 
-    auto* m = new Eigen::SparseMatrix<int, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
-
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        int val = normalize ? (int) round((float) ROUNDING_ACCURACY / (float) nrNonZero) : 1;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
-
-    m->makeCompressed();
-
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
-
-    for (int i = 0; i < sILength; ++i) {
-        int startIter = spectraIdx[i];
-        int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
-        auto* v = new Eigen::SparseVector<int, Eigen::ColMajor>(ENCODING_SIZE);
-        v->reserve(APPROX_NNZ_PER_ROW);
-        for (int j = startIter; j < endIter; ++j) {
-            auto currentPeak = spectraValues[j];
-            auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-            auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
-
-            for (int k = minPeak; k <= maxPeak; ++k) {
-                int currentVal = v->coeffRef(k);
-                int newVal = gaussianTol ? (int) round(normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) * (float) ROUNDING_ACCURACY) : 1;
-                v->coeffRef(k) = max(currentVal, newVal);
-            }
-        }
-
-        auto* spmv = new Eigen::Vector<int, Eigen::Dynamic>(cILength);
-        *spmv = Eigen::Product(*m, *v);
-
-        std::vector<int> colValues;
-        colValues.resize(spmv->size());
-        Eigen::Map<Eigen::Vector<int, Eigen::Dynamic>>(colValues.data(), spmv->size()) = *spmv;
+    auto* m = createCandidateMatrix<float>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
 
-        auto* idx = new int[cILength];
-        std::iota(idx, idx + cILength, 0);
-        std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
-
-        for (int j = 0; j < n; ++j) {
-            result[i * n + j] = idx[j];
-        }
-
-        delete[] idx;
-
-        spmv->resize(0);
-        v->resize(0);
-        delete spmv;
-        delete v;
-        spmv = NULL;
-        v = NULL;
-
-        if (verbose != 0 && (i + 1) % verbose == 0) {
-            std::cout << "Searched " << i + 1 << " spectra in total..." << std::endl;
-        }
-    }
+    searchSparseVector<float>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, scores);
 
     m->resize(0, 0);
     delete m;
     m = NULL;
-
-    return result;
 }
 
 /// <summary>
-/// A function that calculates the top n candidates for each spectrum (SpM*V) using f32 operations. 
+/// A function that calculates the top n candidates for each spectrum (SpM*SpV) using i32 operations. 
+/// Spectra are searched in parallel on the given number of cores.
 /// </summary>
 /// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
 /// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
@@ -342,100 +926,271 @@ int* findTopCandidatesInt(int* candidatesValues, int* candidatesIdx,
 /// <param name="tolerance">Tolerance for peak matching (float).</param>
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
 /// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
-int* findTopCandidates2(int* candidatesValues, int* candidatesIdx,
-                        int* spectraValues, int* spectraIdx,
-                        int cVLength, int cILength,
-                        int sVLength, int sILength,
-                        int n, float tolerance,
-                        bool normalize, bool gaussianTol,
-                        int cores, int verbose) {
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidatesInt(int* candidatesValues, int* candidatesIdx,
+                          int* spectraValues, int* spectraIdx,
+                          int cVLength, int cILength,
+                          int sVLength, int sILength,
+                          int n, float tolerance,
+                          bool normalize, bool gaussianTol,
+                          int cores, int verbose) {
+
+    return findTopCandidatesIntWithScores(candidatesValues, candidatesIdx,
+                                          spectraValues, spectraIdx,
+                                          cVLength, cILength,
+                                          sVLength, sILength,
+                                          n, tolerance,
+                                          normalize, gaussianTol,
+                                          cores, verbose,
+                                          NULL);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*SpV) using i32 operations. 
+/// Spectra are searched in parallel on the given number of cores.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidatesIntWithScores(int* candidatesValues, int* candidatesIdx,
+                                    int* spectraValues, int* spectraIdx,
+                                    int cVLength, int cILength,
+                                    int sVLength, int sILength,
+                                    int n, float tolerance,
+                                    bool normalize, bool gaussianTol,
+                                    int cores, int verbose,
+                                    int* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidatesIntInto(candidatesValues, candidatesIdx,
+                             spectraValues, spectraIdx,
+                             cVLength, cILength,
+                             sVLength, sILength,
+                             n, tolerance,
+                             normalize, gaussianTol,
+                             cores, verbose,
+                             result.get(), scores);
+
+    return result.release();
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*SpV) using i32 operations. 
+/// Spectra are searched in parallel on the given number of cores. The indexes are written to a caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+void findTopCandidatesIntInto(int* candidatesValues, int* candidatesIdx,
+                              int* spectraValues, int* spectraIdx,
+                              int cVLength, int cILength,
+                              int sVLength, int sILength,
+                              int n, float tolerance,
+                              bool normalize, bool gaussianTol,
+                              int cores, int verbose,
+                              int* result, int* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
 
     if (n > cILength) {
         throw std::invalid_argument("Cannot return more hits than number of candidates!");
     }
 
+    if (tolerance < 0.01f) {
+        throw std::invalid_argument("Tolerance must not be smaller than 0.01 for i32 operations!");
+    }
+
     int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
+    usedCores = useThreadPool(cores);
 
-    std::cout << "Running Eigen f32 dense vector search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Running Eigen i32 sparse vector search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
     std::cout << "Using " << usedCores << " threads in total." << std::endl;
 
-    auto* m = new Eigen::SparseMatrix<float, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
+    auto* m = createCandidateMatrix<int>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
 
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        float val = normalize ? 1.0 / (float) nrNonZero : 1.0;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
+    searchSparseVector<int>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, scores);
 
-    m->makeCompressed();
+    m->resize(0, 0);
+    delete m;
+    m = NULL;
+}
 
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*V) using f32 operations. 
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+int* findTopCandidates2(int* candidatesValues, int* candidatesIdx,
+                        int* spectraValues, int* spectraIdx,
+                        int cVLength, int cILength,
+                        int sVLength, int sILength,
+                        int n, float tolerance,
+                        bool normalize, bool gaussianTol,
+                        int cores, int verbose) {
 
-    for (int i = 0; i < sILength; ++i) {
-        int startIter = spectraIdx[i];
-        int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
-        auto* v = new Eigen::Vector<float, Eigen::Dynamic>(ENCODING_SIZE);
-        v->setZero();
-        for (int j = startIter; j < endIter; ++j) {
-            auto currentPeak = spectraValues[j];
-            auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-            auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
+    return findTopCandidates2WithScores(candidatesValues, candidatesIdx,
+                                        spectraValues, spectraIdx,
+                                        cVLength, cILength,
+                                        sVLength, sILength,
+                                        n, tolerance,
+                                        normalize, gaussianTol,
+                                        cores, verbose,
+                                        NULL);
+}
 
-            for (int k = minPeak; k <= maxPeak; ++k) {
-                float currentVal = v->coeffRef(k);
-                float newVal = gaussianTol ? normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) : 1.0;
-                v->coeffRef(k) = max(currentVal, newVal);
-            }
-        }
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*V) using f32 operations. 
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+int* findTopCandidates2WithScores(int* candidatesValues, int* candidatesIdx,
+                                  int* spectraValues, int* spectraIdx,
+                                  int cVLength, int cILength,
+                                  int sVLength, int sILength,
+                                  int n, float tolerance,
+                                  bool normalize, bool gaussianTol,
+                                  int cores, int verbose,
+                                  float* scores) {
 
-        auto* spmv = new Eigen::Vector<float, Eigen::Dynamic>(cILength);
-        *spmv = Eigen::Product(*m, *v);
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
 
-        std::vector<float> colValues;
-        colValues.resize(spmv->size());
-        Eigen::Map<Eigen::Vector<float, Eigen::Dynamic>>(colValues.data(), spmv->size()) = *spmv;
+    findTopCandidates2Into(candidatesValues, candidatesIdx,
+                           spectraValues, spectraIdx,
+                           cVLength, cILength,
+                           sVLength, sILength,
+                           n, tolerance,
+                           normalize, gaussianTol,
+                           cores, verbose,
+                           result.get(), scores);
 
-        auto* idx = new int[cILength];
-        std::iota(idx, idx + cILength, 0);
-        std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
+    return result.release();
+}
 
-        for (int j = 0; j < n; ++j) {
-            result[i * n + j] = idx[j];
-        }
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*V) using f32 operations. The indexes are written to a
+/// caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+void findTopCandidates2Into(int* candidatesValues, int* candidatesIdx,
+                            int* spectraValues, int* spectraIdx,
+                            int cVLength, int cILength,
+                            int sVLength, int sILength,
+                            int n, float tolerance,
+                            bool normalize, bool gaussianTol,
+                            int cores, int verbose,
+                            int* result, float* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
 
-        delete[] idx;
+    if (n > cILength) {
+        throw std::invalid_argument("Cannot return more hits than number of candidates!");
+    }
 
-        spmv->resize(0);
-        v->resize(0);
-        delete spmv;
-        delete v;
-        spmv = NULL;
-        v = NULL;
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
 
-        if (verbose != 0 && (i + 1) % verbose == 0) {
-            std::cout << "Searched " << i + 1 << " spectra in total..." << std::endl;
-        }
-    }
+    std::cout << "Running Eigen f32 dense vector search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    auto* m = createCandidateMatrix<float>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
+
+    searchDenseVector<float>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, scores);
 
     m->resize(0, 0);
     delete m;
     m = NULL;
-
-    return result;
 }
 
 /// <summary>
@@ -453,7 +1208,7 @@ int* findTopCandidates2(int* candidatesValues, int* candidatesIdx,
 /// <param name="tolerance">Tolerance for peak matching (float >= 0.01).</param>
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
 /// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
@@ -466,6 +1221,99 @@ int* findTopCandidates2Int(int* candidatesValues, int* candidatesIdx,
                            bool normalize, bool gaussianTol,
                            int cores, int verbose) {
 
+    return findTopCandidates2IntWithScores(candidatesValues, candidatesIdx,
+                                           spectraValues, spectraIdx,
+                                           cVLength, cILength,
+                                           sVLength, sILength,
+                                           n, tolerance,
+                                           normalize, gaussianTol,
+                                           cores, verbose,
+                                           NULL);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*V) using i32 operations. 
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float >= 0.01).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidates2IntWithScores(int* candidatesValues, int* candidatesIdx,
+                                     int* spectraValues, int* spectraIdx,
+                                     int cVLength, int cILength,
+                                     int sVLength, int sILength,
+                                     int n, float tolerance,
+                                     bool normalize, bool gaussianTol,
+                                     int cores, int verbose,
+                                     int* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidates2IntInto(candidatesValues, candidatesIdx,
+                              spectraValues, spectraIdx,
+                              cVLength, cILength,
+                              sVLength, sILength,
+                              n, tolerance,
+                              normalize, gaussianTol,
+                              cores, verbose,
+                              result.get(), scores);
+
+    return result.release();
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*V) using i32 operations. The indexes are written to a
+/// caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float >= 0.01).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+void findTopCandidates2IntInto(int* candidatesValues, int* candidatesIdx,
+                               int* spectraValues, int* spectraIdx,
+                               int cVLength, int cILength,
+                               int sVLength, int sILength,
+                               int n, float tolerance,
+                               bool normalize, bool gaussianTol,
+                               int cores, int verbose,
+                               int* result, int* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
+
     if (n > cILength) {
         throw std::invalid_argument("Cannot return more hits than number of candidates!");
     }
@@ -475,87 +1323,23 @@ int* findTopCandidates2Int(int* candidatesValues, int* candidatesIdx,
     }
 
     int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
+    usedCores = useThreadPool(cores);
 
     std::cout << "Running Eigen i32 dense vector search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
     std::cout << "Using " << usedCores << " threads in total." << std::endl;
 
-    auto* m = new Eigen::SparseMatrix<int, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
-
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        int val = normalize ? (int) round((float) ROUNDING_ACCURACY / (float) nrNonZero) : 1;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
-
-    m->makeCompressed();
-
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
-
-    for (int i = 0; i < sILength; ++i) {
-        int startIter = spectraIdx[i];
-        int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
-        auto* v = new Eigen::Vector<int, Eigen::Dynamic>(ENCODING_SIZE);
-        v->setZero();
-        for (int j = startIter; j < endIter; ++j) {
-            auto currentPeak = spectraValues[j];
-            auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-            auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
-
-            for (int k = minPeak; k <= maxPeak; ++k) {
-                int currentVal = v->coeffRef(k);
-                int newVal = gaussianTol ? (int) round(normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) * (float) ROUNDING_ACCURACY) : 1;
-                v->coeffRef(k) = max(currentVal, newVal);
-            }
-        }
-
-        auto* spmv = new Eigen::Vector<int, Eigen::Dynamic>(cILength);
-        *spmv = Eigen::Product(*m, *v);
-
-        std::vector<int> colValues;
-        colValues.resize(spmv->size());
-        Eigen::Map<Eigen::Vector<int, Eigen::Dynamic>>(colValues.data(), spmv->size()) = *spmv;
-
-        auto* idx = new int[cILength];
-        std::iota(idx, idx + cILength, 0);
-        std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
-
-        for (int j = 0; j < n; ++j) {
-            result[i * n + j] = idx[j];
-        }
-
-        delete[] idx;
+    auto* m = createCandidateMatrix<int>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
 
-        spmv->resize(0);
-        v->resize(0);
-        delete spmv;
-        delete v;
-        spmv = NULL;
-        v = NULL;
-
-        if (verbose != 0 && (i + 1) % verbose == 0) {
-            std::cout << "Searched " << i + 1 << " spectra in total..." << std::endl;
-        }
-    }
+    searchDenseVector<int>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, scores);
 
     m->resize(0, 0);
     delete m;
     m = NULL;
-
-    return result;
 }
 
 /// <summary>
 /// A function that calculates the top n candidates for each spectrum (SpM*SpM) using f32 operations.
+/// Batches of spectra are searched in parallel on the given number of cores.
 /// </summary>
 /// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
 /// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
@@ -570,7 +1354,7 @@ int* findTopCandidates2Int(int* candidatesValues, int* candidatesIdx,
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
 /// <param name="batchSize">How many spectra (int) should be searched at once.</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
 /// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
@@ -583,119 +1367,126 @@ int* findTopCandidatesBatched(int* candidatesValues, int* candidatesIdx,
                               int batchSize,
                               int cores, int verbose) {
 
-    if (n > cILength) {
-        throw std::invalid_argument("Cannot return more hits than number of candidates!");
-    }
-
-    int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
-
-    std::cout << "Running Eigen f32 sparse matrix search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
-    std::cout << "Using " << usedCores << " threads in total." << std::endl;
-
-    auto* m = new Eigen::SparseMatrix<float, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
+    return findTopCandidatesBatchedWithScores(candidatesValues, candidatesIdx,
+                                              spectraValues, spectraIdx,
+                                              cVLength, cILength,
+                                              sVLength, sILength,
+                                              n, tolerance,
+                                              normalize, gaussianTol,
+                                              batchSize,
+                                              cores, verbose,
+                                              NULL);
+}
 
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        float val = normalize ? 1.0 / (float) nrNonZero : 1.0;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
-
-    m->makeCompressed();
-
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
-
-    for (int i = 0; i < sILength; i += batchSize) {
-
-        auto* M = new Eigen::SparseMatrix<float, Eigen::RowMajor>(ENCODING_SIZE, batchSize);
-        std::vector<Eigen::Triplet<float>> M_entries;
-        M_entries.reserve(1000 * batchSize);
-
-        for (int s = 0; s < batchSize; ++s) {
-
-            if (i + s >= sILength) {
-                break;
-            }
-
-            int startIter = spectraIdx[i + s];
-            int endIter = i + s + 1 == sILength ? sVLength : spectraIdx[i + s + 1];
-            auto* v = new float[ENCODING_SIZE] {0.0};
-            for (int j = startIter; j < endIter; ++j) {
-                auto currentPeak = spectraValues[j];
-                auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-                auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
-
-                for (int k = minPeak; k <= maxPeak; ++k) {
-                    float currentVal = v[k];
-                    float newVal = gaussianTol ? normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) : 1.0;
-                    v[k] = max(currentVal, newVal);
-                }
-            }
-            for (int j = 0; j < ENCODING_SIZE; ++j) {
-                if (v[j] != 0.0) {
-                    M_entries.push_back(Eigen::Triplet<float>(j, s, v[j]));
-                }
-            }
-            delete[] v;
-        }
-
-        M->setFromTriplets(M_entries.begin(), M_entries.end());
-        M->makeCompressed();
-
-        auto* spmM = new Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>(cILength, batchSize);
-        *spmM = Eigen::Product(*m, *M);
-
-        for (int s = 0; s < batchSize; ++s) {
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*SpM) using f32 operations.
+/// Batches of spectra are searched in parallel on the given number of cores.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+int* findTopCandidatesBatchedWithScores(int* candidatesValues, int* candidatesIdx,
+                                        int* spectraValues, int* spectraIdx,
+                                        int cVLength, int cILength,
+                                        int sVLength, int sILength,
+                                        int n, float tolerance,
+                                        bool normalize, bool gaussianTol,
+                                        int batchSize,
+                                        int cores, int verbose,
+                                        float* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidatesBatchedInto(candidatesValues, candidatesIdx,
+                                 spectraValues, spectraIdx,
+                                 cVLength, cILength,
+                                 sVLength, sILength,
+                                 n, tolerance,
+                                 normalize, gaussianTol,
+                                 batchSize,
+                                 cores, verbose,
+                                 result.get(), scores);
+
+    return result.release();
+}
 
-            if (i + s >= sILength) {
-                break;
-            }
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*SpM) using f32 operations.
+/// Batches of spectra are searched in parallel on the given number of cores. The indexes are written to a caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+void findTopCandidatesBatchedInto(int* candidatesValues, int* candidatesIdx,
+                                  int* spectraValues, int* spectraIdx,
+                                  int cVLength, int cILength,
+                                  int sVLength, int sILength,
+                                  int n, float tolerance,
+                                  bool normalize, bool gaussianTol,
+                                  int batchSize,
+                                  int cores, int verbose,
+                                  int* result, float* scores) {
 
-            std::vector<float> colValues;
-            colValues.resize(spmM->rows());
-            Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>>(colValues.data(), spmM->rows(), 1) = spmM->col(s);
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
 
-            auto* idx = new int[cILength];
-            std::iota(idx, idx + cILength, 0);
-            std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
+    if (n > cILength) {
+        throw std::invalid_argument("Cannot return more hits than number of candidates!");
+    }
 
-            for (int j = 0; j < n; ++j) {
-                result[(i + s) * n + j] = idx[j];
-            }
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
 
-            delete[] idx;
-        }
+    std::cout << "Running Eigen f32 sparse matrix search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
 
-        spmM->resize(0, 0);
-        delete spmM;
-        spmM = NULL;
-        M->resize(0, 0);
-        delete M;
-        M = NULL;
+    auto* m = createCandidateMatrix<float>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
 
-        if (verbose != 0 && (i + batchSize) % verbose == 0) {
-            std::cout << "Searched " << i + batchSize << " spectra in total..." << std::endl;
-        }
-    }
+    searchSparseMatrix<float>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, scores);
 
     m->resize(0, 0);
     delete m;
     m = NULL;
-
-    return result;
 }
 
 /// <summary>
 /// A function that calculates the top n candidates for each spectrum (SpM*SpM) using i32 operations.
+/// Batches of spectra are searched in parallel on the given number of cores.
 /// </summary>
 /// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
 /// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
@@ -710,7 +1501,7 @@ int* findTopCandidatesBatched(int* candidatesValues, int* candidatesIdx,
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
 /// <param name="batchSize">How many spectra (int) should be searched at once.</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
 /// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
@@ -724,6 +1515,106 @@ int* findTopCandidatesBatchedInt(int* candidatesValues, int* candidatesIdx,
                                  int batchSize,
                                  int cores, int verbose) {
 
+    return findTopCandidatesBatchedIntWithScores(candidatesValues, candidatesIdx,
+                                                 spectraValues, spectraIdx,
+                                                 cVLength, cILength,
+                                                 sVLength, sILength,
+                                                 n, tolerance,
+                                                 normalize, gaussianTol,
+                                                 batchSize,
+                                                 cores, verbose,
+                                                 NULL);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*SpM) using i32 operations.
+/// Batches of spectra are searched in parallel on the given number of cores.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidatesBatchedIntWithScores(int* candidatesValues, int* candidatesIdx,
+                                           int* spectraValues, int* spectraIdx,
+                                           int cVLength, int cILength,
+                                           int sVLength, int sILength,
+                                           int n, float tolerance,
+                                           bool normalize, bool gaussianTol,
+                                           int batchSize,
+                                           int cores, int verbose,
+                                           int* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidatesBatchedIntInto(candidatesValues, candidatesIdx,
+                                    spectraValues, spectraIdx,
+                                    cVLength, cILength,
+                                    sVLength, sILength,
+                                    n, tolerance,
+                                    normalize, gaussianTol,
+                                    batchSize,
+                                    cores, verbose,
+                                    result.get(), scores);
+
+    return result.release();
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*SpM) using i32 operations.
+/// Batches of spectra are searched in parallel on the given number of cores. The indexes are written to a caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+void findTopCandidatesBatchedIntInto(int* candidatesValues, int* candidatesIdx,
+                                     int* spectraValues, int* spectraIdx,
+                                     int cVLength, int cILength,
+                                     int sVLength, int sILength,
+                                     int n, float tolerance,
+                                     bool normalize, bool gaussianTol,
+                                     int batchSize,
+                                     int cores, int verbose,
+                                     int* result, int* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
+
     if (n > cILength) {
         throw std::invalid_argument("Cannot return more hits than number of candidates!");
     }
@@ -733,110 +1624,18 @@ int* findTopCandidatesBatchedInt(int* candidatesValues, int* candidatesIdx,
     }
 
     int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
+    usedCores = useThreadPool(cores);
 
     std::cout << "Running Eigen i32 sparse matrix search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
     std::cout << "Using " << usedCores << " threads in total." << std::endl;
 
-    auto* m = new Eigen::SparseMatrix<int, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
-
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        int val = normalize ? (int) round((float) ROUNDING_ACCURACY / (float) nrNonZero) : 1;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
-
-    m->makeCompressed();
-
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
-
-    for (int i = 0; i < sILength; i += batchSize) {
-
-        auto* M = new Eigen::SparseMatrix<int, Eigen::RowMajor>(ENCODING_SIZE, batchSize);
-        std::vector<Eigen::Triplet<int>> M_entries;
-        M_entries.reserve(1000 * batchSize);
-
-        for (int s = 0; s < batchSize; ++s) {
-
-            if (i + s >= sILength) {
-                break;
-            }
-
-            int startIter = spectraIdx[i + s];
-            int endIter = i + s + 1 == sILength ? sVLength : spectraIdx[i + s + 1];
-            auto* v = new int[ENCODING_SIZE] {0};
-            for (int j = startIter; j < endIter; ++j) {
-                auto currentPeak = spectraValues[j];
-                auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-                auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
-
-                for (int k = minPeak; k <= maxPeak; ++k) {
-                    int currentVal = v[k];
-                    int newVal = gaussianTol ? (int) round(normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) * (float) ROUNDING_ACCURACY) : 1;
-                    v[k] = max(currentVal, newVal);
-                }
-            }
-            for (int j = 0; j < ENCODING_SIZE; ++j) {
-                if (v[j] != 0) {
-                    M_entries.push_back(Eigen::Triplet<int>(j, s, v[j]));
-                }
-            }
-            delete[] v;
-        }
-
-        M->setFromTriplets(M_entries.begin(), M_entries.end());
-        M->makeCompressed();
-
-        auto* spmM = new Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>(cILength, batchSize);
-        *spmM = Eigen::Product(*m, *M);
+    auto* m = createCandidateMatrix<int>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
 
-        for (int s = 0; s < batchSize; ++s) {
-
-            if (i + s >= sILength) {
-                break;
-            }
-
-            std::vector<int> colValues;
-            colValues.resize(spmM->rows());
-            Eigen::Map<Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>>(colValues.data(), spmM->rows(), 1) = spmM->col(s);
-
-            auto* idx = new int[cILength];
-            std::iota(idx, idx + cILength, 0);
-            std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
-
-            for (int j = 0; j < n; ++j) {
-                result[(i + s) * n + j] = idx[j];
-            }
-
-            delete[] idx;
-        }
-
-        spmM->resize(0, 0);
-        delete spmM;
-        spmM = NULL;
-        M->resize(0, 0);
-        delete M;
-        M = NULL;
-
-        if (verbose != 0 && (i + batchSize) % verbose == 0) {
-            std::cout << "Searched " << i + batchSize << " spectra in total..." << std::endl;
-        }
-    }
+    searchSparseMatrix<int>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, scores);
 
     m->resize(0, 0);
     delete m;
     m = NULL;
-
-    return result;
 }
 
 /// <summary>
@@ -855,7 +1654,7 @@ int* findTopCandidatesBatchedInt(int* candidatesValues, int* candidatesIdx,
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
 /// <param name="batchSize">How many spectra (int) should be searched at once.</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
 /// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
@@ -868,108 +1667,19 @@ int* findTopCandidatesBatched2(int* candidatesValues, int* candidatesIdx,
                                int batchSize,
                                int cores, int verbose) {
 
-    if (n > cILength) {
-        throw std::invalid_argument("Cannot return more hits than number of candidates!");
-    }
-
-    int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
-
-    std::cout << "Running Eigen f32 dense matrix search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
-    std::cout << "Using " << usedCores << " threads in total." << std::endl;
-
-    auto* m = new Eigen::SparseMatrix<float, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
-
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        float val = normalize ? 1.0 / (float) nrNonZero : 1.0;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
-
-    m->makeCompressed();
-
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
-
-    for (int i = 0; i < sILength; i += batchSize) {
-
-        auto* M = new Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>(ENCODING_SIZE, batchSize);
-        M->setZero();
-
-        for (int s = 0; s < batchSize; ++s) {
-
-            if (i + s >= sILength) {
-                break;
-            }
-
-            int startIter = spectraIdx[i + s];
-            int endIter = i + s + 1 == sILength ? sVLength : spectraIdx[i + s + 1];
-            for (int j = startIter; j < endIter; ++j) {
-                auto currentPeak = spectraValues[j];
-                auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-                auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
-
-                for (int k = minPeak; k <= maxPeak; ++k) {
-                    float currentVal = M->coeff(k, s);
-                    float newVal = gaussianTol ? normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) : 1.0;
-                    M->coeffRef(k, s) = max(currentVal, newVal);
-                }
-            }
-        }
-
-        auto* spmM = new Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>(cILength, batchSize);
-        *spmM = Eigen::Product(*m, *M);
-
-        for (int s = 0; s < batchSize; ++s) {
-
-            if (i + s >= sILength) {
-                break;
-            }
-
-            std::vector<float> colValues;
-            colValues.resize(spmM->rows());
-            Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>>(colValues.data(), spmM->rows(), 1) = spmM->col(s);
-
-            auto* idx = new int[cILength];
-            std::iota(idx, idx + cILength, 0);
-            std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
-
-            for (int j = 0; j < n; ++j) {
-                result[(i + s) * n + j] = idx[j];
-            }
-
-            delete[] idx;
-        }
-
-        spmM->resize(0, 0);
-        delete spmM;
-        spmM = NULL;
-        M->resize(0, 0);
-        delete M;
-        M = NULL;
-
-        if (verbose != 0 && (i + batchSize) % verbose == 0) {
-            std::cout << "Searched " << i + batchSize << " spectra in total..." << std::endl;
-        }
-    }
-
-    m->resize(0, 0);
-    delete m;
-    m = NULL;
-
-    return result;
+    return findTopCandidatesBatched2WithScores(candidatesValues, candidatesIdx,
+                                               spectraValues, spectraIdx,
+                                               cVLength, cILength,
+                                               sVLength, sILength,
+                                               n, tolerance,
+                                               normalize, gaussianTol,
+                                               batchSize,
+                                               cores, verbose,
+                                               NULL);
 }
 
 /// <summary>
-/// A function that calculates the top n candidates for each spectrum (SpM*M) using i32 operations.
+/// A function that calculates the top n candidates for each spectrum (SpM*M) using f32 operations.
 /// </summary>
 /// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
 /// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
@@ -980,64 +1690,3898 @@ int* findTopCandidatesBatched2(int* candidatesValues, int* candidatesIdx,
 /// <param name="sVLength">Length (int) of spectraValues.</param>
 /// <param name="sILength">Length (int) of spectraIdx.</param>
 /// <param name="n">How many of the best hits should be returned (int).</param>
-/// <param name="tolerance">Tolerance for peak matching (float >= 0.01).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
 /// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
 /// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
 /// <param name="batchSize">How many spectra (int) should be searched at once.</param>
-/// <param name="cores">Number of cores (int) used by Eigen.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
 /// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
 /// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
 /// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
-/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
-int* findTopCandidatesBatched2Int(int* candidatesValues, int* candidatesIdx,
-                                  int* spectraValues, int* spectraIdx,
-                                  int cVLength, int cILength,
-                                  int sVLength, int sILength,
-                                  int n, float tolerance,
-                                  bool normalize, bool gaussianTol,
-                                  int batchSize,
-                                  int cores, int verbose) {
+int* findTopCandidatesBatched2WithScores(int* candidatesValues, int* candidatesIdx,
+                                         int* spectraValues, int* spectraIdx,
+                                         int cVLength, int cILength,
+                                         int sVLength, int sILength,
+                                         int n, float tolerance,
+                                         bool normalize, bool gaussianTol,
+                                         int batchSize,
+                                         int cores, int verbose,
+                                         float* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidatesBatched2Into(candidatesValues, candidatesIdx,
+                                  spectraValues, spectraIdx,
+                                  cVLength, cILength,
+                                  sVLength, sILength,
+                                  n, tolerance,
+                                  normalize, gaussianTol,
+                                  batchSize,
+                                  cores, verbose,
+                                  result.get(), scores);
+
+    return result.release();
+}
 
-    if (n > cILength) {
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*M) using f32 operations. The indexes are written to a
+/// caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+void findTopCandidatesBatched2Into(int* candidatesValues, int* candidatesIdx,
+                                   int* spectraValues, int* spectraIdx,
+                                   int cVLength, int cILength,
+                                   int sVLength, int sILength,
+                                   int n, float tolerance,
+                                   bool normalize, bool gaussianTol,
+                                   int batchSize,
+                                   int cores, int verbose,
+                                   int* result, float* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
+
+    if (n > cILength) {
+        throw std::invalid_argument("Cannot return more hits than number of candidates!");
+    }
+
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
+
+    std::cout << "Running Eigen f32 dense matrix search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    auto* m = createCandidateMatrix<float>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
+
+    searchDenseMatrix<float>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, scores);
+
+    m->resize(0, 0);
+    delete m;
+    m = NULL;
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*M) using i32 operations.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float >= 0.01).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidatesBatched2Int(int* candidatesValues, int* candidatesIdx,
+                                  int* spectraValues, int* spectraIdx,
+                                  int cVLength, int cILength,
+                                  int sVLength, int sILength,
+                                  int n, float tolerance,
+                                  bool normalize, bool gaussianTol,
+                                  int batchSize,
+                                  int cores, int verbose) {
+
+    return findTopCandidatesBatched2IntWithScores(candidatesValues, candidatesIdx,
+                                                  spectraValues, spectraIdx,
+                                                  cVLength, cILength,
+                                                  sVLength, sILength,
+                                                  n, tolerance,
+                                                  normalize, gaussianTol,
+                                                  batchSize,
+                                                  cores, verbose,
+                                                  NULL);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*M) using i32 operations.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float >= 0.01).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidatesBatched2IntWithScores(int* candidatesValues, int* candidatesIdx,
+                                            int* spectraValues, int* spectraIdx,
+                                            int cVLength, int cILength,
+                                            int sVLength, int sILength,
+                                            int n, float tolerance,
+                                            bool normalize, bool gaussianTol,
+                                            int batchSize,
+                                            int cores, int verbose,
+                                            int* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidatesBatched2IntInto(candidatesValues, candidatesIdx,
+                                     spectraValues, spectraIdx,
+                                     cVLength, cILength,
+                                     sVLength, sILength,
+                                     n, tolerance,
+                                     normalize, gaussianTol,
+                                     batchSize,
+                                     cores, verbose,
+                                     result.get(), scores);
+
+    return result.release();
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum (SpM*M) using i32 operations. The indexes are written to a
+/// caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float >= 0.01).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+void findTopCandidatesBatched2IntInto(int* candidatesValues, int* candidatesIdx,
+                                      int* spectraValues, int* spectraIdx,
+                                      int cVLength, int cILength,
+                                      int sVLength, int sILength,
+                                      int n, float tolerance,
+                                      bool normalize, bool gaussianTol,
+                                      int batchSize,
+                                      int cores, int verbose,
+                                      int* result, int* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
+
+    if (n > cILength) {
+        throw std::invalid_argument("Cannot return more hits than number of candidates!");
+    }
+
+    if (tolerance < 0.01f) {
+        throw std::invalid_argument("Tolerance must not be smaller than 0.01 for i32 operations!");
+    }
+
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
+
+    std::cout << "Running Eigen i32 dense matrix search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    auto* m = createCandidateMatrix<int>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
+
+    searchDenseMatrix<int>(candidateMatrixView(*m, normalize), DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, scores);
+
+    m->resize(0, 0);
+    delete m;
+    m = NULL;
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using an inverted index of the candidates using f32 operations.
+/// Only candidates that share at least one ion with a spectrum are scored, so the work per spectrum depends on the number of matched
+/// ions instead of the number of candidates. Spectra are searched in parallel.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+int* findTopCandidatesInverted(int* candidatesValues, int* candidatesIdx,
+                               int* spectraValues, int* spectraIdx,
+                               int cVLength, int cILength,
+                               int sVLength, int sILength,
+                               int n, float tolerance,
+                               bool normalize, bool gaussianTol,
+                               int cores, int verbose) {
+
+    return findTopCandidatesInvertedWithScores(candidatesValues, candidatesIdx,
+                                               spectraValues, spectraIdx,
+                                               cVLength, cILength,
+                                               sVLength, sILength,
+                                               n, tolerance,
+                                               normalize, gaussianTol,
+                                               cores, verbose,
+                                               NULL);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using an inverted index of the candidates using f32 operations.
+/// Only candidates that share at least one ion with a spectrum are scored, so the work per spectrum depends on the number of matched
+/// ions instead of the number of candidates. Spectra are searched in parallel.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+int* findTopCandidatesInvertedWithScores(int* candidatesValues, int* candidatesIdx,
+                                         int* spectraValues, int* spectraIdx,
+                                         int cVLength, int cILength,
+                                         int sVLength, int sILength,
+                                         int n, float tolerance,
+                                         bool normalize, bool gaussianTol,
+                                         int cores, int verbose,
+                                         float* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidatesInvertedInto(candidatesValues, candidatesIdx,
+                                  spectraValues, spectraIdx,
+                                  cVLength, cILength,
+                                  sVLength, sILength,
+                                  n, tolerance,
+                                  normalize, gaussianTol,
+                                  cores, verbose,
+                                  result.get(), scores);
+
+    return result.release();
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using an inverted index of the candidates using f32 operations.
+/// Only candidates that share at least one ion with a spectrum are scored, so the work per spectrum depends on the number of matched
+/// ions instead of the number of candidates. Spectra are searched in parallel. The indexes are written to a caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (f32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+void findTopCandidatesInvertedInto(int* candidatesValues, int* candidatesIdx,
+                                   int* spectraValues, int* spectraIdx,
+                                   int cVLength, int cILength,
+                                   int sVLength, int sILength,
+                                   int n, float tolerance,
+                                   bool normalize, bool gaussianTol,
+                                   int cores, int verbose,
+                                   int* result, float* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
+
+    if (n > cILength) {
         throw std::invalid_argument("Cannot return more hits than number of candidates!");
     }
 
-    if (tolerance < 0.01f) {
-        throw std::invalid_argument("Tolerance must not be smaller than 0.01 for i32 operations!");
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
+
+    std::cout << "Running Eigen f32 inverted index search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    auto* m = createCandidateMatrix<float>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
+    auto* inverted = createInvertedCandidateMatrix<float>(candidateMatrixView(*m, normalize));
+
+    searchInvertedVector<float>(candidateMatrixView(*m, normalize), *inverted, DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, scores);
+
+    delete inverted;
+    inverted = NULL;
+    m->resize(0, 0);
+    delete m;
+    m = NULL;
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using an inverted index of the candidates using i32 operations.
+/// Only candidates that share at least one ion with a spectrum are scored, so the work per spectrum depends on the number of matched
+/// ions instead of the number of candidates. Spectra are searched in parallel.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidatesInvertedInt(int* candidatesValues, int* candidatesIdx,
+                                  int* spectraValues, int* spectraIdx,
+                                  int cVLength, int cILength,
+                                  int sVLength, int sILength,
+                                  int n, float tolerance,
+                                  bool normalize, bool gaussianTol,
+                                  int cores, int verbose) {
+
+    return findTopCandidatesInvertedIntWithScores(candidatesValues, candidatesIdx,
+                                                  spectraValues, spectraIdx,
+                                                  cVLength, cILength,
+                                                  sVLength, sILength,
+                                                  n, tolerance,
+                                                  normalize, gaussianTol,
+                                                  cores, verbose,
+                                                  NULL);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using an inverted index of the candidates using i32 operations.
+/// Only candidates that share at least one ion with a spectrum are scored, so the work per spectrum depends on the number of matched
+/// ions instead of the number of candidates. Spectra are searched in parallel.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+int* findTopCandidatesInvertedIntWithScores(int* candidatesValues, int* candidatesIdx,
+                                            int* spectraValues, int* spectraIdx,
+                                            int cVLength, int cILength,
+                                            int sVLength, int sILength,
+                                            int n, float tolerance,
+                                            bool normalize, bool gaussianTol,
+                                            int cores, int verbose,
+                                            int* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    findTopCandidatesInvertedIntInto(candidatesValues, candidatesIdx,
+                                     spectraValues, spectraIdx,
+                                     cVLength, cILength,
+                                     sVLength, sILength,
+                                     n, tolerance,
+                                     normalize, gaussianTol,
+                                     cores, verbose,
+                                     result.get(), scores);
+
+    return result.release();
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using an inverted index of the candidates using i32 operations.
+/// Only candidates that share at least one ion with a spectrum are scored, so the work per spectrum depends on the number of matched
+/// ions instead of the number of candidates. Spectra are searched in parallel. The indexes are written to a caller-provided array.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score (i32) of every returned candidate is written to, NULL if scores are
+/// not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if result is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than cILength, cannot return more hits than number of candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance is smaller than 0.01, smaller tolerances would cause an integer overflow.</exception>
+void findTopCandidatesInvertedIntInto(int* candidatesValues, int* candidatesIdx,
+                                      int* spectraValues, int* spectraIdx,
+                                      int cVLength, int cILength,
+                                      int sVLength, int sILength,
+                                      int n, float tolerance,
+                                      bool normalize, bool gaussianTol,
+                                      int cores, int verbose,
+                                      int* result, int* scores) {
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
+
+    if (n > cILength) {
+        throw std::invalid_argument("Cannot return more hits than number of candidates!");
+    }
+
+    if (tolerance < 0.01f) {
+        throw std::invalid_argument("Tolerance must not be smaller than 0.01 for i32 operations!");
+    }
+
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
+
+    std::cout << "Running Eigen i32 inverted index search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    auto* m = createCandidateMatrix<int>(candidatesValues, candidatesIdx, cVLength, cILength, normalize, ENCODING_SIZE);
+    auto* inverted = createInvertedCandidateMatrix<int>(candidateMatrixView(*m, normalize));
+
+    searchInvertedVector<int>(candidateMatrixView(*m, normalize), *inverted, DEFAULT_GEOMETRY, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, scores);
+
+    delete inverted;
+    inverted = NULL;
+    m->resize(0, 0);
+    delete m;
+    m = NULL;
+}
+
+/// <summary>
+/// A function that creates a persistent candidate index that can be searched multiple times with searchCandidateIndex.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="useInt">If the candidate matrix should use i32 (true) or f32 (false) values (bool).</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>A pointer to the candidate index, the index has to be released with releaseCandidateIndex.</returns>
+CandidateIndex* createCandidateIndex(int* candidatesValues, int* candidatesIdx,
+                                     int cVLength, int cILength,
+                                     bool normalize, bool useInt,
+                                     int cores) {
+
+    return createCandidateIndexWithStorage(candidatesValues, candidatesIdx, cVLength, cILength, normalize, useInt, CSR_STORAGE, cores);
+}
+
+/// <summary>
+/// A function that creates a persistent candidate index with the given storage layout that can be searched multiple times with
+/// searchCandidateIndex. Delta encoded column indices (COMPRESSED_COLUMNS) need roughly half the memory of 32-bit column indices, storing
+/// no values (PATTERN_ONLY) saves 4 bytes per ion since all ions of a candidate have the same value. Both layouts can be combined, but only
+/// support the dense vector, inverted index and bitmap index methods.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="useInt">If the candidate matrix should use i32 (true) or f32 (false) values (bool).</param>
+/// <param name="storage">The storage layout (int) of the candidate matrix, a combination of IndexStorage flags.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>A pointer to the candidate index, the index has to be released with releaseCandidateIndex.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the storage layout is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a candidate contains an ion beyond 5000 m/z.</exception>
+CandidateIndex* createCandidateIndexWithStorage(int* candidatesValues, int* candidatesIdx,
+                                                int cVLength, int cILength,
+                                                bool normalize, bool useInt,
+                                                int storage,
+                                                int cores) {
+
+    return createCandidateIndexWithGeometry(candidatesValues, candidatesIdx, cVLength, cILength, normalize, useInt, storage, MASS_RANGE, MASS_MULTIPLIER, cores);
+}
+
+/// <summary>
+/// A function that creates a persistent candidate index with the given storage layout and encoding geometry that can be searched multiple
+/// times with searchCandidateIndex. Ions and peaks have to be encoded with massMultiplier bins per m/z, e.g. 1000 for a precision of 0.001.
+/// If massRange is 0 the encoding size follows the largest ion of the candidates instead of a fixed m/z range, so low mass workloads do
+/// not pay for bins that no candidate uses. Spectrum peaks beyond the encoding size are discarded, since no candidate could match them.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="useInt">If the candidate matrix should use i32 (true) or f32 (false) values (bool).</param>
+/// <param name="storage">The storage layout (int) of the candidate matrix, a combination of IndexStorage flags.</param>
+/// <param name="massRange">Largest m/z (int) that is encoded, 0 derives the encoding size from the largest ion of the candidates.</param>
+/// <param name="massMultiplier">Number of bins per m/z (int) ions and peaks are encoded with, the encoding precision is 1 / massMultiplier.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>A pointer to the candidate index, the index has to be released with releaseCandidateIndex.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the storage layout is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if massMultiplier is smaller than 1, massRange is negative or the encoding size exceeds
+/// 2^31 - 1 bins.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a candidate contains an ion beyond massRange.</exception>
+CandidateIndex* createCandidateIndexWithGeometry(int* candidatesValues, int* candidatesIdx,
+                                                 int cVLength, int cILength,
+                                                 bool normalize, bool useInt,
+                                                 int storage,
+                                                 int massRange, int massMultiplier,
+                                                 int cores) {
+
+    std::vector<int64_t> candidatesIdx64(candidatesIdx, candidatesIdx + cILength);
+
+    return createCandidateIndex64(candidatesValues, candidatesIdx64.data(), cVLength, cILength, normalize, useInt, storage, massRange, massMultiplier, cores);
+}
+
+/// <summary>
+/// A function that creates a persistent candidate index like createCandidateIndexWithGeometry from candidates with 64-bit offsets, so that
+/// the candidates may contain more than 2^31 - 1 ions in total. The candidates are split into segments of at most MAX_SEGMENT_NNZ ions, the
+/// offsets within a segment and all column indices stay 32-bit so that the memory needed per ion does not grow. Ions and peaks have to be
+/// encoded with massMultiplier bins per m/z, e.g. 1000 for a precision of 0.001. If massRange is 0 the encoding size follows the largest
+/// ion of the candidates instead of a fixed m/z range, so low mass workloads do not pay for bins that no candidate uses. Spectrum peaks
+/// beyond the encoding size are discarded, since no candidate could match them.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">A 64-bit integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int64) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="useInt">If the candidate matrix should use i32 (true) or f32 (false) values (bool).</param>
+/// <param name="storage">The storage layout (int) of the candidate matrix, a combination of IndexStorage flags.</param>
+/// <param name="massRange">Largest m/z (int) that is encoded, 0 derives the encoding size from the largest ion of the candidates.</param>
+/// <param name="massMultiplier">Number of bins per m/z (int) ions and peaks are encoded with, the encoding precision is 1 / massMultiplier.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>A pointer to the candidate index, the index has to be released with releaseCandidateIndex.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the storage layout is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if massMultiplier is smaller than 1, massRange is negative or the encoding size exceeds
+/// 2^31 - 1 bins.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a candidate contains an ion beyond massRange.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a single candidate contains more than 2^31 - 1 ions.</exception>
+CandidateIndex* createCandidateIndex64(int* candidatesValues, int64_t* candidatesIdx,
+                                       int64_t cVLength, int cILength,
+                                       bool normalize, bool useInt,
+                                       int storage,
+                                       int massRange, int massMultiplier,
+                                       int cores) {
+
+    if (storage < CSR_STORAGE || storage > (COMPRESSED_COLUMNS | PATTERN_ONLY)) {
+        throw std::invalid_argument("Unknown storage layout!");
+    }
+
+    if (massMultiplier < 1 || massRange < 0 || (int64_t) massRange * massMultiplier > INT32_MAX) {
+        throw std::invalid_argument("Mass multiplier must be positive and the encoding size must not exceed 2^31 - 1 bins!");
+    }
+
+    int64_t firstIdx = cILength > 0 ? candidatesIdx[0] : 0;
+    int largestIon = largestCandidateIon(candidatesValues, firstIdx, cVLength);
+
+    if (largestIon == INT32_MAX || (massRange > 0 && largestIon >= massRange * massMultiplier)) {
+        throw std::invalid_argument("Candidate ions must not exceed the mass range of the encoding!");
+    }
+
+    std::vector<int> segmentBounds = splitOffsetRanges(candidatesIdx, cVLength, cILength, MAX_SEGMENT_NNZ);
+
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
+
+    std::cout << "Creating Eigen " << (useInt ? "i32" : "f32") << " candidate index version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    auto* index = new CandidateIndex;
+    index->cILength = 0;
+    index->nnz = 0;
+    index->normalize = normalize;
+    index->useInt = useInt;
+    index->storage = storage;
+    index->geometry.massMultiplier = massMultiplier;
+    index->geometry.encodingSize = massRange > 0 ? massRange * massMultiplier : (largestIon >= 0 ? largestIon + 1 : 1);
+    index->mapping = NULL;
+    index->mappingSize = 0;
+    index->invertedF32 = NULL;
+    index->invertedI32 = NULL;
+    index->bitmapF32 = NULL;
+    index->bitmapI32 = NULL;
+
+    appendCandidateSegments(index, candidatesValues, candidatesIdx, cVLength, segmentBounds);
+
+    int rows = 0;
+    for (const auto& segment : index->segments) {
+        rows += segment.rows;
+    }
+
+    if (rows < cILength) {
+        std::cout << "Stored " << rows << " unique candidates of " << cILength << " candidates." << std::endl;
+    }
+
+    return index;
+}
+
+/// <summary>
+/// A function that creates a persistent candidate index that adopts a candidate matrix in CSR format without copying it, so that callers
+/// that already hold the row offsets and column indices skip building the candidate matrix. The arrays are wrapped as a single pattern only
+/// segment (PATTERN_ONLY) whose values are computed from the row lengths while searching, hence only the dense vector, inverted index and
+/// bitmap index methods are supported. Identical candidates are not deduplicated. The arrays are only read and have to stay valid and
+/// unchanged until the index is released with releaseCandidateIndex, appended candidates and compaction use owned storage as usual.
+/// </summary>
+/// <param name="csrRowoffsets">An integer array of row offsets (rows + 1) into csrColIdx, row i is the candidate with index i.</param>
+/// <param name="csrColIdx">An integer array of the encoded ions (column indices) of all candidates, sorted within every row.</param>
+/// <param name="rows">Number of candidates (int), the number of rows of the CSR matrix.</param>
+/// <param name="nnz">Length (int) of csrColIdx.</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="useInt">If the candidate matrix should use i32 (true) or f32 (false) values (bool).</param>
+/// <param name="massRange">Largest m/z (int) that is encoded, 0 derives the encoding size from the largest ion of the candidates.</param>
+/// <param name="massMultiplier">Number of bins per m/z (int) ions and peaks are encoded with, the encoding precision is 1 / massMultiplier.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>A pointer to the candidate index, the index has to be released with releaseCandidateIndex.</returns>
+/// <exception cref="std::invalid_argument">Thrown if csrRowoffsets or csrColIdx is NULL or the number of rows or ions is negative.</exception>
+/// <exception cref="std::invalid_argument">Thrown if massMultiplier is smaller than 1, massRange is negative or the encoding size exceeds
+/// 2^31 - 1 bins.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the row offsets do not start at 0, decrease or do not end at nnz.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the column indices of a row are not sorted or a column index is outside of the
+/// encoding.</exception>
+CandidateIndex* createCandidateIndexFromCSR(int* csrRowoffsets, int* csrColIdx,
+                                            int rows, int nnz,
+                                            bool normalize, bool useInt,
+                                            int massRange, int massMultiplier,
+                                            int cores) {
+
+    if (csrRowoffsets == NULL || (csrColIdx == NULL && nnz > 0) || rows < 0 || nnz < 0) {
+        throw std::invalid_argument("CSR arrays must not be NULL and their lengths must not be negative!");
+    }
+
+    if (massMultiplier < 1 || massRange < 0 || (int64_t) massRange * massMultiplier > INT32_MAX) {
+        throw std::invalid_argument("Mass multiplier must be positive and the encoding size must not exceed 2^31 - 1 bins!");
+    }
+
+    if (csrRowoffsets[0] != 0 || csrRowoffsets[rows] != nnz) {
+        throw std::invalid_argument("Row offsets must start at 0 and end at the number of ions!");
+    }
+
+    int largestIon = largestCandidateIon(csrColIdx, 0, nnz);
+
+    if (largestIon == INT32_MAX || (massRange > 0 && largestIon >= massRange * massMultiplier)) {
+        throw std::invalid_argument("Candidate ions must not exceed the mass range of the encoding!");
+    }
+
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
+
+    std::cout << "Adopting CSR candidate matrix as Eigen " << (useInt ? "i32" : "f32") << " candidate index version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    // the arrays are not copied, so a single pass checks that they form a valid sorted CSR matrix
+    std::atomic<bool> validOffsets(true);
+    std::atomic<bool> validColumns(true);
+    parallelFor(rows, [&](int i) {
+        int rowStart = csrRowoffsets[i];
+        int rowEnd = csrRowoffsets[i + 1];
+        if (rowEnd < rowStart || rowStart < 0 || rowEnd > nnz) {
+            validOffsets = false;
+        } else if (rowEnd > rowStart && (csrColIdx[rowStart] < 0 || !std::is_sorted(csrColIdx + rowStart, csrColIdx + rowEnd))) {
+            validColumns = false;
+        }
+    });
+
+    if (!validOffsets) {
+        throw std::invalid_argument("Row offsets must not decrease!");
+    }
+
+    if (!validColumns) {
+        throw std::invalid_argument("Column indices must not be negative and have to be sorted within every row!");
+    }
+
+    auto* index = new CandidateIndex;
+    index->cILength = rows;
+    index->nnz = nnz;
+    index->normalize = normalize;
+    index->useInt = useInt;
+    index->storage = PATTERN_ONLY;
+    index->geometry.massMultiplier = massMultiplier;
+    index->geometry.encodingSize = massRange > 0 ? massRange * massMultiplier : (largestIon >= 0 ? largestIon + 1 : 1);
+    index->mapping = NULL;
+    index->mappingSize = 0;
+    index->invertedF32 = NULL;
+    index->invertedI32 = NULL;
+    index->bitmapF32 = NULL;
+    index->bitmapI32 = NULL;
+
+    // the segment borrows the caller arrays like a memory mapped segment, releaseCandidateSegment leaves them untouched
+    CandidateSegment segment;
+    segment.rows = rows;
+    segment.nnz = nnz;
+    segment.cols = index->geometry.encodingSize;
+    segment.candidates = rows;
+    segment.firstCandidate = 0;
+    segment.mF32 = NULL;
+    segment.mI32 = NULL;
+    segment.outerIndex = csrRowoffsets;
+    segment.innerIndex = csrColIdx;
+    segment.valuesF32 = NULL;
+    segment.valuesI32 = NULL;
+    segment.rowCandidateOffsets = NULL;
+    segment.rowCandidates = NULL;
+    segment.candidateMap = NULL;
+    segment.columnDeltas = NULL;
+    segment.columnDeltaOffsets = NULL;
+    segment.arrays = NULL;
+    index->segments.push_back(segment);
+
+    return index;
+}
+
+/// <summary>
+/// A function that appends candidates to an existing candidate index. The appended candidates are stored in a new segment, so the cost
+/// only depends on the number of appended candidates. The appended candidates get the indices following the existing candidates, if
+/// the index consists of more than MAX_INDEX_SEGMENTS segments afterwards it is compacted into a single segment. Appended candidates
+/// are only deduplicated against each other until the index is compacted.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex or loadCandidateIndex.</param>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all appended candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each appended candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>The index (int) of the first appended candidate.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the index is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the index would contain more than 2^31 - 1 candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if an appended candidate contains an ion beyond the encoding size of the index.</exception>
+int appendCandidateIndex(CandidateIndex* index,
+                         int* candidatesValues, int* candidatesIdx,
+                         int cVLength, int cILength,
+                         int cores) {
+
+    std::vector<int64_t> candidatesIdx64(candidatesIdx, candidatesIdx + cILength);
+
+    return appendCandidateIndex64(index, candidatesValues, candidatesIdx64.data(), cVLength, cILength, cores);
+}
+
+/// <summary>
+/// A function that appends candidates with 64-bit offsets to an existing candidate index. The appended candidates are stored in new
+/// segments of at most MAX_SEGMENT_NNZ ions, so the cost only depends on the number of appended candidates. The appended candidates get the
+/// indices following the existing candidates, if the index consists of more than MAX_INDEX_SEGMENTS segments afterwards it is compacted
+/// into a single segment. Appended candidates are only deduplicated against each other until the index is compacted.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex or loadCandidateIndex.</param>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all appended candidates flattened.</param>
+/// <param name="candidatesIdx">A 64-bit integer array that contains indices of where each appended candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int64) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>The index (int) of the first appended candidate.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the index is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the index would contain more than 2^31 - 1 candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if an appended candidate contains an ion beyond the encoding size of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a single appended candidate contains more than 2^31 - 1 ions.</exception>
+int appendCandidateIndex64(CandidateIndex* index,
+                           int* candidatesValues, int64_t* candidatesIdx,
+                           int64_t cVLength, int cILength,
+                           int cores) {
+
+    if (index == NULL) {
+        throw std::invalid_argument("Candidate index must not be NULL!");
+    }
+
+    int64_t firstIdx = cILength > 0 ? candidatesIdx[0] : 0;
+
+    if ((int64_t) index->cILength + cILength > INT32_MAX) {
+        throw std::invalid_argument("Candidate index must not contain more than 2^31 - 1 candidates!");
+    }
+
+    if (largestCandidateIon(candidatesValues, firstIdx, cVLength) >= index->geometry.encodingSize) {
+        throw std::invalid_argument("Candidate ions must not exceed the mass range of the candidate index!");
+    }
+
+    int firstCandidate = index->cILength;
+
+    if (cILength == 0) {
+        return firstCandidate;
+    }
+
+    std::vector<int> segmentBounds = splitOffsetRanges(candidatesIdx, cVLength, cILength, MAX_SEGMENT_NNZ);
+
+    useThreadPool(cores);
+    releaseInvertedCandidateMatrices(index);
+
+    appendCandidateSegments(index, candidatesValues, candidatesIdx, cVLength, segmentBounds);
+
+    if (index->segments.size() > MAX_INDEX_SEGMENTS) {
+        compactCandidateIndex(index, cores);
+    }
+
+    return firstCandidate;
+}
+
+/// <summary>
+/// A function that begins building a candidate index from chunks of candidates, so that the candidates never have to be passed or held in
+/// memory all at once. Chunks are appended with appendCandidateIndexChunk and the index is completed with finishCandidateIndex. Collected
+/// chunks are encoded as a new segment of the index every BUILDER_SEGMENT_NNZ ions, identical candidates are merged within a segment.
+/// </summary>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="useInt">If the index should be searched with i32 (true) or f32 (false) methods (bool).</param>
+/// <param name="storage">The storage layout (int) of the index, see IndexStorage.</param>
+/// <param name="massRange">Largest m/z (int) that is encoded, has to be known before the first chunk is appended.</param>
+/// <param name="massMultiplier">Number of bins per m/z (int) ions are encoded with, e.g. 100 for a precision of 0.01.</param>
+/// <returns>A pointer to the candidate index builder, the builder has to be completed with finishCandidateIndex or released with
+/// releaseCandidateIndexBuilder.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the storage layout is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if massMultiplier or massRange is not positive or the encoding size exceeds 2^31 - 1
+/// bins.</exception>
+CandidateIndexBuilder* beginCandidateIndex(bool normalize, bool useInt,
+                                           int storage,
+                                           int massRange, int massMultiplier) {
+
+    if (storage < CSR_STORAGE || storage > (COMPRESSED_COLUMNS | PATTERN_ONLY)) {
+        throw std::invalid_argument("Unknown storage layout!");
+    }
+
+    if (massMultiplier < 1 || massRange < 1 || (int64_t) massRange * massMultiplier > INT32_MAX) {
+        throw std::invalid_argument("Mass multiplier and mass range must be positive and the encoding size must not exceed 2^31 - 1 bins!");
+    }
+
+    std::cout << "Building Eigen " << (useInt ? "i32" : "f32") << " candidate index version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+
+    auto* index = new CandidateIndex;
+    index->cILength = 0;
+    index->nnz = 0;
+    index->normalize = normalize;
+    index->useInt = useInt;
+    index->storage = storage;
+    index->geometry.massMultiplier = massMultiplier;
+    index->geometry.encodingSize = massRange * massMultiplier;
+    index->mapping = NULL;
+    index->mappingSize = 0;
+    index->invertedF32 = NULL;
+    index->invertedI32 = NULL;
+    index->bitmapF32 = NULL;
+    index->bitmapI32 = NULL;
+
+    auto* builder = new CandidateIndexBuilder;
+    builder->index = index;
+
+    return builder;
+}
+
+/// <summary>
+/// A function that appends a chunk of candidates to a candidate index builder created with beginCandidateIndex. The chunk is copied, so its
+/// arrays can be reused by the caller right away. Chunks are encoded as soon as BUILDER_SEGMENT_NNZ ions have been collected.
+/// </summary>
+/// <param name="builder">The candidate index builder created with beginCandidateIndex.</param>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates of the chunk flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate of the chunk starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used to encode the collected candidates, 0 uses all threads of the pool.</param>
+/// <returns>The index (int) of the first candidate of the chunk in the candidate index.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the builder is NULL.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the index would contain more than 2^31 - 1 candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a candidate of the chunk contains an ion beyond the mass range of the builder.</exception>
+int appendCandidateIndexChunk(CandidateIndexBuilder* builder,
+                              int* candidatesValues, int* candidatesIdx,
+                              int cVLength, int cILength,
+                              int cores) {
+
+    if (builder == NULL) {
+        throw std::invalid_argument("Candidate index builder must not be NULL!");
+    }
+
+    int firstCandidate = builder->index->cILength + (int) builder->pendingIdx.size();
+    int firstIdx = cILength > 0 ? candidatesIdx[0] : 0;
+
+    if ((int64_t) firstCandidate + cILength > INT32_MAX) {
+        throw std::invalid_argument("Candidate index must not contain more than 2^31 - 1 candidates!");
+    }
+
+    if (largestCandidateIon(candidatesValues, firstIdx, cVLength) >= builder->index->geometry.encodingSize) {
+        throw std::invalid_argument("Candidate ions must not exceed the mass range of the candidate index!");
+    }
+
+    int64_t pendingOffset = (int64_t) builder->pendingValues.size() - firstIdx;
+    for (int i = 0; i < cILength; ++i) {
+        builder->pendingIdx.push_back(pendingOffset + candidatesIdx[i]);
+    }
+    builder->pendingValues.insert(builder->pendingValues.end(), candidatesValues + firstIdx, candidatesValues + cVLength);
+
+    if ((int64_t) builder->pendingValues.size() >= BUILDER_SEGMENT_NNZ) {
+        useThreadPool(cores);
+        flushCandidateIndexBuilder(builder);
+    }
+
+    return firstCandidate;
+}
+
+/// <summary>
+/// A function that encodes the remaining candidates of a candidate index builder and returns the completed candidate index. The builder is
+/// released by this function and must not be used afterwards. The segments of the index are not merged, see compactCandidateIndex.
+/// </summary>
+/// <param name="builder">The candidate index builder created with beginCandidateIndex.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used to encode the remaining candidates, 0 uses all threads of the pool.</param>
+/// <returns>A pointer to the candidate index, the index has to be released with releaseCandidateIndex.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the builder is NULL.</exception>
+CandidateIndex* finishCandidateIndex(CandidateIndexBuilder* builder, int cores) {
+
+    if (builder == NULL) {
+        throw std::invalid_argument("Candidate index builder must not be NULL!");
+    }
+
+    // an index without candidates still gets an empty segment like an index created from no candidates
+    if (!builder->pendingIdx.empty() || builder->index->segments.empty()) {
+        useThreadPool(cores);
+        flushCandidateIndexBuilder(builder);
+    }
+
+    auto* index = builder->index;
+    builder->index = NULL;
+    delete builder;
+
+    int rows = 0;
+    for (const auto& segment : index->segments) {
+        rows += segment.rows;
+    }
+
+    std::cout << "Built Eigen " << (index->useInt ? "i32" : "f32") << " candidate index with " << index->cILength << " candidates in " << index->segments.size() << " segments." << std::endl;
+
+    if (rows < index->cILength) {
+        std::cout << "Stored " << rows << " unique candidates of " << index->cILength << " candidates." << std::endl;
+    }
+
+    return index;
+}
+
+/// <summary>
+/// Free the memory of a candidate index builder that was not completed with finishCandidateIndex, including the candidates encoded so far.
+/// </summary>
+/// <param name="builder">The candidate index builder.</param>
+/// <returns>0</returns>
+int releaseCandidateIndexBuilder(CandidateIndexBuilder* builder) {
+
+    if (builder == NULL) {
+        return 0;
+    }
+
+    releaseCandidateIndex(builder->index);
+    builder->index = NULL;
+
+    delete builder;
+    return 0;
+}
+
+/// <summary>
+/// A function that merges the segments of a candidate index into as few segments of at most MAX_SEGMENT_NNZ ions as possible, identical
+/// candidates of merged segments are merged into a single row. Candidate indices do not change, a memory mapped index is copied into memory
+/// and the index file is unmapped.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex or loadCandidateIndex.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <returns>0</returns>
+/// <exception cref="std::invalid_argument">Thrown if the index is NULL.</exception>
+int compactCandidateIndex(CandidateIndex* index, int cores) {
+
+    if (index == NULL) {
+        throw std::invalid_argument("Candidate index must not be NULL!");
+    }
+
+    if (index->segments.size() <= 1) {
+        return 0;
+    }
+
+    useThreadPool(cores);
+    releaseInvertedCandidateMatrices(index);
+
+    // consecutive segments are merged as long as the merged segment fits into 32-bit offsets, a segment that cannot be merged with its
+    // neighbours is kept as it is unless it is memory mapped
+    std::vector<CandidateSegment> segments;
+    std::vector<bool> kept(index->segments.size(), false);
+    size_t first = 0;
+    while (first < index->segments.size()) {
+        size_t last = first + 1;
+        int64_t nnz = index->segments[first].nnz;
+        while (last < index->segments.size() && nnz + index->segments[last].nnz <= MAX_SEGMENT_NNZ) {
+            nnz += index->segments[last].nnz;
+            ++last;
+        }
+
+        if (last == first + 1 && index->mapping == NULL) {
+            segments.push_back(index->segments[first]);
+            kept[first] = true;
+            first = last;
+            continue;
+        }
+
+        int firstCandidate = index->segments[first].firstCandidate;
+        auto segment = index->useInt ? createCandidateSegment(mergeCandidateSegments<int>(index, first, last), firstCandidate) :
+                                       createCandidateSegment(mergeCandidateSegments<float>(index, first, last), firstCandidate);
+        segment.candidateMap = mergeCandidateMaps(index, first, last);
+        segment.candidates = 0;
+        for (size_t k = first; k < last; ++k) {
+            segment.candidates += index->segments[k].candidates;
+        }
+        if (segment.candidateMap != NULL) {
+            segment.rowCandidateOffsets = segment.candidateMap->data();
+            segment.rowCandidates = segment.candidateMap->data() + segment.rows + 1;
+        }
+
+        if (index->useInt) {
+            finishCandidateSegment<int>(segment, index->storage);
+        } else {
+            finishCandidateSegment<float>(segment, index->storage);
+        }
+
+        segments.push_back(segment);
+        first = last;
+    }
+
+    for (size_t k = 0; k < index->segments.size(); ++k) {
+        if (!kept[k]) {
+            releaseCandidateSegment(index->segments[k]);
+        }
+    }
+
+    index->segments = segments;
+    index->nnz = 0;
+    for (const auto& segment : index->segments) {
+        index->nnz += segment.nnz;
+    }
+
+    if (index->mapping != NULL) {
+        unmapIndexFile(index->mapping, index->mappingSize);
+        index->mapping = NULL;
+        index->mappingSize = 0;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using a previously created candidate index.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float), has to cover at least one bin of the encoding for i32 methods (>= 0.01 for
+/// the default geometry).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="method">Which search method (int) should be used, see SearchMethod. The precision has to match the precision of the index.</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once, only used by the matrix methods.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the index is NULL or the method is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the method is not supported by the storage layout of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a bitmap index method is used with gaussianTol.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the precision of the method does not match the precision of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than the number of candidates, cannot return more hits than number of
+/// candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance covers less than one bin for i32 methods, smaller tolerances would cause an
+/// integer overflow.</exception>
+int* searchCandidateIndex(CandidateIndex* index,
+                          int* spectraValues, int* spectraIdx,
+                          int sVLength, int sILength,
+                          int n, float tolerance,
+                          bool gaussianTol,
+                          int method, int batchSize,
+                          int cores, int verbose) {
+
+    return searchCandidateIndexWithScores(index,
+                                          spectraValues, spectraIdx,
+                                          sVLength, sILength,
+                                          n, tolerance,
+                                          gaussianTol,
+                                          method, batchSize,
+                                          cores, verbose,
+                                          NULL);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using a previously created candidate index.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float), has to cover at least one bin of the encoding for i32 methods (>= 0.01 for
+/// the default geometry).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="method">Which search method (int) should be used, see SearchMethod. The precision has to match the precision of the index.</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once, only used by the matrix methods.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score of every returned candidate is written to, a float array for f32
+/// methods and an integer array for i32 methods, NULL if scores are not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the index is NULL or the method is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the method is not supported by the storage layout of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a bitmap index method is used with gaussianTol.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the precision of the method does not match the precision of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than the number of candidates, cannot return more hits than number of
+/// candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance covers less than one bin for i32 methods, smaller tolerances would cause an
+/// integer overflow.</exception>
+int* searchCandidateIndexWithScores(CandidateIndex* index,
+                                    int* spectraValues, int* spectraIdx,
+                                    int sVLength, int sILength,
+                                    int n, float tolerance,
+                                    bool gaussianTol,
+                                    int method, int batchSize,
+                                    int cores, int verbose,
+                                    void* scores) {
+
+    std::vector<int64_t> spectraIdx64(spectraIdx, spectraIdx + sILength);
+
+    return searchCandidateIndex64(index,
+                                  spectraValues, spectraIdx64.data(),
+                                  sVLength, sILength,
+                                  n, tolerance,
+                                  gaussianTol,
+                                  method, batchSize,
+                                  cores, verbose,
+                                  scores);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using a previously created candidate index and writes their indexes
+/// to a caller-provided array.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float), has to cover at least one bin of the encoding for i32 methods (>= 0.01 for
+/// the default geometry).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="method">Which search method (int) should be used, see SearchMethod. The precision has to match the precision of the index.</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once, only used by the matrix methods.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score of every returned candidate is written to, a float array for f32
+/// methods and an integer array for i32 methods, NULL if scores are not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if the index or result is NULL or the method is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the method is not supported by the storage layout of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a bitmap index method is used with gaussianTol.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the precision of the method does not match the precision of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than the number of candidates, cannot return more hits than number of
+/// candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance covers less than one bin for i32 methods, smaller tolerances would cause an
+/// integer overflow.</exception>
+void searchCandidateIndexInto(CandidateIndex* index,
+                              int* spectraValues, int* spectraIdx,
+                              int sVLength, int sILength,
+                              int n, float tolerance,
+                              bool gaussianTol,
+                              int method, int batchSize,
+                              int cores, int verbose,
+                              int* result, void* scores) {
+
+    std::vector<int64_t> spectraIdx64(spectraIdx, spectraIdx + sILength);
+
+    searchCandidateIndex64Into(index,
+                               spectraValues, spectraIdx64.data(),
+                               sVLength, sILength,
+                               n, tolerance,
+                               gaussianTol,
+                               method, batchSize,
+                               cores, verbose,
+                               result, scores);
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using a previously created candidate index, spectra are passed with
+/// 64-bit offsets and the result may contain more than 2^31 - 1 entries. Spectra are searched in chunks of at most MAX_SEGMENT_NNZ peaks.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">A 64-bit integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int64) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float), has to cover at least one bin of the encoding for i32 methods (>= 0.01 for
+/// the default geometry).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="method">Which search method (int) should be used, see SearchMethod. The precision has to match the precision of the index.</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once, only used by the matrix methods.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="scores">An array of length sILength * n that the score of every returned candidate is written to, a float array for f32
+/// methods and an integer array for i32 methods, NULL if scores are not needed.</param>
+/// <returns>An integer array of length sILength * n containing the indexes of the top n candidates for each spectrum.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the index is NULL or the method is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the method is not supported by the storage layout of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a bitmap index method is used with gaussianTol.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the precision of the method does not match the precision of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than the number of candidates, cannot return more hits than number of
+/// candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance covers less than one bin for i32 methods, smaller tolerances would cause an
+/// integer overflow.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a single spectrum contains more than 2^31 - 1 peaks.</exception>
+int* searchCandidateIndex64(CandidateIndex* index,
+                            int* spectraValues, int64_t* spectraIdx,
+                            int64_t sVLength, int sILength,
+                            int n, float tolerance,
+                            bool gaussianTol,
+                            int method, int batchSize,
+                            int cores, int verbose,
+                            void* scores) {
+
+    auto result = std::unique_ptr<int[]>(new int[(int64_t) sILength * n]);
+
+    searchCandidateIndex64Into(index,
+                               spectraValues, spectraIdx,
+                               sVLength, sILength,
+                               n, tolerance,
+                               gaussianTol,
+                               method, batchSize,
+                               cores, verbose,
+                               result.get(), scores);
+
+    return result.release();
+}
+
+/// <summary>
+/// A function that calculates the top n candidates for each spectrum using a previously created candidate index, spectra are passed with
+/// 64-bit offsets and the indexes are written to a caller-provided array that may contain more than 2^31 - 1 entries. Spectra are searched in
+/// chunks of at most MAX_SEGMENT_NNZ peaks.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">A 64-bit integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int64) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float), has to cover at least one bin of the encoding for i32 methods (>= 0.01 for
+/// the default geometry).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="method">Which search method (int) should be used, see SearchMethod. The precision has to match the precision of the index.</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once, only used by the matrix methods.</param>
+/// <param name="cores">Number of cores (int) of the thread pool used by this call, 0 uses all threads of the pool.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of at least sILength * n elements that the indexes of the top n candidates for each spectrum are
+/// written to.</param>
+/// <param name="scores">An array of length sILength * n that the score of every returned candidate is written to, a float array for f32
+/// methods and an integer array for i32 methods, NULL if scores are not needed.</param>
+/// <exception cref="std::invalid_argument">Thrown if the index or result is NULL or the method is unknown.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the method is not supported by the storage layout of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a bitmap index method is used with gaussianTol.</exception>
+/// <exception cref="std::invalid_argument">Thrown if the precision of the method does not match the precision of the index.</exception>
+/// <exception cref="std::invalid_argument">Thrown if n is greater than the number of candidates, cannot return more hits than number of
+/// candidates.</exception>
+/// <exception cref="std::invalid_argument">Thrown if tolerance covers less than one bin for i32 methods, smaller tolerances would cause an
+/// integer overflow.</exception>
+/// <exception cref="std::invalid_argument">Thrown if a single spectrum contains more than 2^31 - 1 peaks.</exception>
+void searchCandidateIndex64Into(CandidateIndex* index,
+                                int* spectraValues, int64_t* spectraIdx,
+                                int64_t sVLength, int sILength,
+                                int n, float tolerance,
+                                bool gaussianTol,
+                                int method, int batchSize,
+                                int cores, int verbose,
+                                int* result, void* scores) {
+
+    if (index == NULL) {
+        throw std::invalid_argument("Candidate index must not be NULL!");
+    }
+
+    if (result == NULL) {
+        throw std::invalid_argument("Result array must not be NULL!");
+    }
+
+    if (method < I32_DV || method > F32_BM) {
+        throw std::invalid_argument("Unknown search method!");
+    }
+
+    bool useInt = method == I32_DV || method == I32_DM || method == I32_SV || method == I32_SM || method == I32_IV || method == I32_BM;
+
+    if (useInt != index->useInt) {
+        throw std::invalid_argument("Precision of the search method does not match the precision of the candidate index!");
+    }
+
+    if (index->storage != CSR_STORAGE && method != I32_DV && method != F32_DV && method != I32_IV && method != F32_IV && method != I32_BM && method != F32_BM) {
+        throw std::invalid_argument("Candidate indices with delta encoded column indices or without values only support dense vector, inverted index and bitmap index methods!");
+    }
+
+    if (gaussianTol && (method == I32_BM || method == F32_BM)) {
+        throw std::invalid_argument("Bitmap index methods only support binary peak matching without gaussian tolerance!");
+    }
+
+    if (n > index->cILength) {
+        throw std::invalid_argument("Cannot return more hits than number of candidates!");
+    }
+
+    if (useInt && round(tolerance * index->geometry.massMultiplier) < 1.0f) {
+        throw std::invalid_argument("Tolerance must cover at least one bin of the encoding for i32 operations!");
+    }
+
+    std::vector<int> chunkBounds = splitOffsetRanges(spectraIdx, sVLength, sILength, MAX_SEGMENT_NNZ);
+
+    const char* methodName = method == I32_DV || method == F32_DV ? "dense vector" :
+                             method == I32_DM || method == F32_DM ? "dense matrix" :
+                             method == I32_SV || method == F32_SV ? "sparse vector" :
+                             method == I32_SM || method == F32_SM ? "sparse matrix" :
+                             method == I32_IV || method == F32_IV ? "inverted index" : "bitmap index";
+
+    int usedCores = 0;
+    usedCores = useThreadPool(cores);
+
+    std::cout << "Running Eigen " << (useInt ? "i32" : "f32") << " " << methodName << " index search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
+    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+
+    // the search methods use 32-bit peak offsets, so the offsets of every chunk of spectra are rebased to its first peak
+    std::vector<int> chunkIdx;
+    for (size_t c = 0; c + 1 < chunkBounds.size(); ++c) {
+        int first = chunkBounds[c];
+        int count = chunkBounds[c + 1] - first;
+        int64_t start = count > 0 ? spectraIdx[first] : 0;
+        int64_t end = count == 0 ? start : chunkBounds[c + 1] == sILength ? sVLength : spectraIdx[chunkBounds[c + 1]];
+
+        chunkIdx.resize(count);
+        for (int i = 0; i < count; ++i) {
+            chunkIdx[i] = (int) (spectraIdx[first + i] - start);
+        }
+
+        // f32 and i32 scores have the same size, so the scores of the chunk start at the same position for both
+        void* chunkScores = scores != NULL ? (void*) ((int*) scores + (int64_t) first * n) : NULL;
+
+        searchIndexSpectra(index, spectraValues + start, chunkIdx.data(), (int) (end - start), count, n, tolerance, gaussianTol,
+                           method, batchSize, verbose, result + (int64_t) first * n, chunkScores);
+    }
+}
+
+/// <summary>
+/// A function that saves a candidate index to a binary index file that can be memory mapped with loadCandidateIndex.
+/// </summary>
+/// <param name="index">The candidate index created with createCandidateIndex or loadCandidateIndex.</param>
+/// <param name="path">Path of the index file, an existing file will be overwritten.</param>
+/// <returns>0 if the index was saved successfully, 1 otherwise.</returns>
+/// <exception cref="std::invalid_argument">Thrown if the index is NULL.</exception>
+int saveCandidateIndex(CandidateIndex* index, const char* path) {
+
+    if (index == NULL) {
+        throw std::invalid_argument("Candidate index must not be NULL!");
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "Could not open " << path << " for writing!" << std::endl;
+        return 1;
+    }
+
+    int64_t valueSize = index->useInt ? sizeof(int) : sizeof(float);
+    bool compressed = (index->storage & COMPRESSED_COLUMNS) != 0;
+    bool patternOnly = (index->storage & PATTERN_ONLY) != 0;
+
+    CandidateIndexFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic));
+    header.version = INDEX_FILE_VERSION;
+    header.flags = (index->normalize ? 1 : 0) | (index->useInt ? 2 : 0) | (compressed ? 8 : 0) | (patternOnly ? 16 : 0);
+    header.segments = (int32_t) index->segments.size();
+    header.cols = index->geometry.encodingSize;
+    header.massMultiplier = index->geometry.massMultiplier;
+    header.nnz = index->nnz;
+    header.candidates = index->cILength;
+
+    // every segment keeps its own 32-bit offsets, so segments are written as they are and only their position in the file is 64-bit
+    std::vector<CandidateIndexFileSegment> entries(index->segments.size());
+    int64_t fileSize = sizeof(header) + (int64_t) entries.size() * sizeof(CandidateIndexFileSegment);
+    for (size_t s = 0; s < index->segments.size(); ++s) {
+        const auto& segment = index->segments[s];
+        auto& entry = entries[s];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.rows = segment.rows;
+        entry.nnz = segment.nnz;
+        entry.candidates = segment.candidates;
+        entry.firstCandidate = segment.firstCandidate;
+        entry.outerIndexOffset = alignIndexFileOffset(fileSize);
+        fileSize = entry.outerIndexOffset + (int64_t) (segment.rows + 1) * sizeof(int32_t);
+        if (compressed) {
+            entry.nrColumnDeltas = segment.columnDeltaOffsets[segment.rows];
+            entry.columnDeltaOffsetsOffset = alignIndexFileOffset(fileSize);
+            entry.columnDeltasOffset = alignIndexFileOffset(entry.columnDeltaOffsetsOffset + (int64_t) (segment.rows + 1) * sizeof(int64_t));
+            fileSize = entry.columnDeltasOffset + entry.nrColumnDeltas * sizeof(uint16_t);
+        } else {
+            entry.innerIndexOffset = alignIndexFileOffset(fileSize);
+            fileSize = entry.innerIndexOffset + (int64_t) segment.nnz * sizeof(int32_t);
+        }
+        if (!patternOnly) {
+            entry.valuesOffset = alignIndexFileOffset(fileSize);
+            fileSize = entry.valuesOffset + (int64_t) segment.nnz * valueSize;
+        }
+        entry.rowValuesOffset = alignIndexFileOffset(fileSize);
+        fileSize = entry.rowValuesOffset + (int64_t) segment.rows * valueSize;
+        if (segment.rowCandidates != NULL) {
+            entry.rowCandidateOffsetsOffset = alignIndexFileOffset(fileSize);
+            entry.rowCandidatesOffset = alignIndexFileOffset(entry.rowCandidateOffsetsOffset + (int64_t) (segment.rows + 1) * sizeof(int32_t));
+            fileSize = entry.rowCandidatesOffset + (int64_t) segment.candidates * sizeof(int32_t);
+        }
+    }
+    header.fileSize = fileSize;
+
+    file.write((const char*) &header, sizeof(header));
+    file.write((const char*) entries.data(), (std::streamsize) (entries.size() * sizeof(CandidateIndexFileSegment)));
+
+    for (const auto& segment : index->segments) {
+        padIndexFile(file);
+        writeIndexArray(file, segment.outerIndex, segment.rows + 1);
+
+        if (compressed) {
+            padIndexFile(file);
+            writeIndexArray(file, segment.columnDeltaOffsets, segment.rows + 1);
+            padIndexFile(file);
+            writeIndexArray(file, segment.columnDeltas, segment.columnDeltaOffsets[segment.rows]);
+        } else {
+            padIndexFile(file);
+            writeIndexArray(file, segment.innerIndex, segment.nnz);
+        }
+
+        if (!patternOnly) {
+            padIndexFile(file);
+            if (index->useInt) {
+                writeIndexArray(file, segment.valuesI32, segment.nnz);
+            } else {
+                writeIndexArray(file, segment.valuesF32, segment.nnz);
+            }
+        }
+
+        // segments without values use the value of a candidate with the same number of ions
+        padIndexFile(file);
+        if (index->useInt) {
+            std::vector<int> rowValues(segment.rows);
+            for (int i = 0; i < segment.rows; ++i) {
+                int rowLength = segment.outerIndex[i + 1] - segment.outerIndex[i];
+                rowValues[i] = rowLength == 0 ? 0 :
+                               segment.valuesI32 == NULL ? candidateValue<int>(rowLength, index->normalize) : segment.valuesI32[segment.outerIndex[i]];
+            }
+            writeIndexArray(file, rowValues.data(), segment.rows);
+        } else {
+            std::vector<float> rowValues(segment.rows);
+            for (int i = 0; i < segment.rows; ++i) {
+                int rowLength = segment.outerIndex[i + 1] - segment.outerIndex[i];
+                rowValues[i] = rowLength == 0 ? 0.0f :
+                               segment.valuesF32 == NULL ? candidateValue<float>(rowLength, index->normalize) : segment.valuesF32[segment.outerIndex[i]];
+            }
+            writeIndexArray(file, rowValues.data(), segment.rows);
+        }
+
+        if (segment.rowCandidates != NULL) {
+            padIndexFile(file);
+            writeIndexArray(file, segment.rowCandidateOffsets, segment.rows + 1);
+            padIndexFile(file);
+            writeIndexArray(file, segment.rowCandidates, segment.candidates);
+        }
+    }
+
+    file.close();
+    if (!file) {
+        std::cout << "Could not write candidate index to " << path << "!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// A function that loads a candidate index from a binary index file created with saveCandidateIndex. The file is memory mapped and
+/// used directly without copying, so loading is almost instant and the pages are shared between all processes using the same file.
+/// The header and the segment table are validated, the contents of the arrays are trusted.
+/// </summary>
+/// <param name="path">Path of the index file.</param>
+/// <returns>A pointer to the candidate index or NULL if the file could not be loaded, the index has to be released with
+/// releaseCandidateIndex.</returns>
+CandidateIndex* loadCandidateIndex(const char* path) {
+
+    size_t size = 0;
+    void* mapping = mapIndexFile(path, &size);
+    if (mapping == NULL) {
+        std::cout << "Could not open candidate index file " << path << "!" << std::endl;
+        return NULL;
+    }
+
+    const auto* header = (const CandidateIndexFileHeader*) mapping;
+    if (size < sizeof(CandidateIndexFileHeader) ||
+        std::memcmp(header->magic, INDEX_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != INDEX_FILE_VERSION ||
+        header->cols < 1 ||
+        header->massMultiplier < 1 ||
+        header->segments < 1 ||
+        header->fileSize != (int64_t) size ||
+        size < sizeof(CandidateIndexFileHeader) + (size_t) header->segments * sizeof(CandidateIndexFileSegment)) {
+        std::cout << path << " is not a valid candidate index file of version " << INDEX_FILE_VERSION << "!" << std::endl;
+        unmapIndexFile(mapping, size);
+        return NULL;
+    }
+
+    const char* data = (const char*) mapping;
+
+    // the segment table is checked before anything is read through it, the segments have to cover the candidates and ions of the header
+    const auto* entries = (const CandidateIndexFileSegment*) (data + sizeof(CandidateIndexFileHeader));
+    int64_t tableEnd = sizeof(CandidateIndexFileHeader) + (int64_t) header->segments * sizeof(CandidateIndexFileSegment);
+    int64_t candidates = 0;
+    int64_t nnz = 0;
+    bool validSegments = true;
+    for (int s = 0; s < header->segments && validSegments; ++s) {
+        validSegments = entries[s].firstCandidate == candidates &&
+                        validIndexFileSegment(entries[s], data, size, tableEnd, (header->flags & 8) != 0, (header->flags & 16) != 0);
+        candidates += entries[s].candidates;
+        nnz += entries[s].nnz;
+    }
+    if (!validSegments || candidates != header->candidates || nnz != header->nnz) {
+        std::cout << path << " has an invalid segment table!" << std::endl;
+        unmapIndexFile(mapping, size);
+        return NULL;
+    }
+
+    auto* index = new CandidateIndex;
+    index->cILength = header->candidates;
+    index->nnz = header->nnz;
+    index->normalize = (header->flags & 1) != 0;
+    index->useInt = (header->flags & 2) != 0;
+    index->storage = ((header->flags & 8) != 0 ? COMPRESSED_COLUMNS : CSR_STORAGE) | ((header->flags & 16) != 0 ? PATTERN_ONLY : CSR_STORAGE);
+    index->geometry.massMultiplier = header->massMultiplier;
+    index->geometry.encodingSize = header->cols;
+
+    bool compressed = (index->storage & COMPRESSED_COLUMNS) != 0;
+    bool patternOnly = (index->storage & PATTERN_ONLY) != 0;
+
+    for (int s = 0; s < header->segments; ++s) {
+        const auto& entry = entries[s];
+        CandidateSegment segment;
+        segment.rows = entry.rows;
+        segment.nnz = entry.nnz;
+        segment.cols = header->cols;
+        segment.candidates = entry.candidates;
+        segment.firstCandidate = entry.firstCandidate;
+        segment.mF32 = NULL;
+        segment.mI32 = NULL;
+        segment.outerIndex = (const int*) (data + entry.outerIndexOffset);
+        segment.innerIndex = compressed ? NULL : (const int*) (data + entry.innerIndexOffset);
+        segment.valuesF32 = index->useInt || patternOnly ? NULL : (const float*) (data + entry.valuesOffset);
+        segment.valuesI32 = index->useInt && !patternOnly ? (const int*) (data + entry.valuesOffset) : NULL;
+        segment.rowCandidateOffsets = entry.rowCandidateOffsetsOffset != 0 ? (const int*) (data + entry.rowCandidateOffsetsOffset) : NULL;
+        segment.rowCandidates = entry.rowCandidatesOffset != 0 ? (const int*) (data + entry.rowCandidatesOffset) : NULL;
+        segment.candidateMap = NULL;
+        segment.columnDeltas = compressed ? (const uint16_t*) (data + entry.columnDeltasOffset) : NULL;
+        segment.columnDeltaOffsets = compressed ? (const int64_t*) (data + entry.columnDeltaOffsetsOffset) : NULL;
+        segment.arrays = NULL;
+        index->segments.push_back(segment);
+    }
+
+    index->mapping = mapping;
+    index->mappingSize = size;
+    index->invertedF32 = NULL;
+    index->invertedI32 = NULL;
+    index->bitmapF32 = NULL;
+    index->bitmapI32 = NULL;
+
+    std::cout << "Loaded Eigen " << (index->useInt ? "i32" : "f32") << " candidate index with " << index->cILength << " candidates from " << path << std::endl;
+
+    return index;
+}
+
+/// <summary>
+/// Free the memory of a candidate index created with createCandidateIndex.
+/// </summary>
+/// <param name="index">The candidate index.</param>
+/// <returns>0</returns>
+int releaseCandidateIndex(CandidateIndex* index) {
+
+    if (index == NULL) {
+        return 0;
+    }
+
+    for (auto& segment : index->segments) {
+        releaseCandidateSegment(segment);
+    }
+
+    releaseInvertedCandidateMatrices(index);
+
+    if (index->mapping != NULL) {
+        unmapIndexFile(index->mapping, index->mappingSize);
+        index->mapping = NULL;
+    }
+
+    delete index;
+    return 0;
+}
+
+/// <summary>
+/// A function that (re)creates the thread pool of the library. Without calling this function a pool with one thread per hardware thread
+/// is created when it is first used. Must not be called while another function of the library is running.
+/// </summary>
+/// <param name="threads">Number of threads (int) of the pool including the calling thread, 0 uses one thread per hardware thread.</param>
+/// <param name="pinThreads">If every worker thread should be pinned to its own CPU (bool), worker i is pinned to CPU i modulo the number of CPUs.
+/// The calling thread is not pinned.</param>
+/// <returns>0 if the pool was created and all threads were pinned successfully, 1 otherwise.</returns>
+int configureThreadPool(int threads, bool pinThreads) {
+
+    std::lock_guard<std::mutex> lock(threadPoolMutex);
+
+    if (globalThreadPool != NULL) {
+        {
+            std::lock_guard<std::mutex> poolLock(globalThreadPool->mutex);
+            globalThreadPool->stop = true;
+        }
+        globalThreadPool->taskAvailable.notify_all();
+        for (auto& worker : globalThreadPool->workers) {
+            worker.join();
+        }
+        delete globalThreadPool;
+        globalThreadPool = NULL;
+    }
+
+    if (threads <= 0) {
+        threads = (int) std::thread::hardware_concurrency();
+    }
+
+    auto* pool = new ThreadPool;
+    pool->stop = false;
+    pool->pinThreads = pinThreads;
+
+    int cpus = (int) std::thread::hardware_concurrency();
+    int status = 0;
+    for (int i = 1; i < threads; ++i) {
+        pool->workers.emplace_back(runThreadPoolWorker, pool);
+        if (pinThreads && !pinThread(pool->workers.back(), cpus > 0 ? i % cpus : i)) {
+            status = 1;
+        }
+    }
+
+    globalThreadPool = pool;
+    return status;
+}
+
+/// <summary>
+/// Free memory after result has been marshalled.
+/// </summary>
+/// <param name="result">The result array.</param>
+/// <returns>0</returns>
+int releaseMemory(int* result) {
+
+    delete[] result;
+    return 0;
+}
+
+/// <summary>
+/// Returns the thread pool of the library, a pool with one thread per hardware thread is created if the pool was not configured yet.
+/// </summary>
+/// <returns>A pointer to the thread pool.</returns>
+ThreadPool* threadPool() {
+    std::lock_guard<std::mutex> lock(threadPoolMutex);
+    if (globalThreadPool == NULL) {
+        auto* pool = new ThreadPool;
+        pool->stop = false;
+        pool->pinThreads = false;
+        int threads = (int) std::thread::hardware_concurrency();
+        for (int i = 1; i < threads; ++i) {
+            pool->workers.emplace_back(runThreadPoolWorker, pool);
+        }
+        globalThreadPool = pool;
+    }
+    return globalThreadPool;
+}
+
+/// <summary>
+/// Runs the tasks of a thread pool until the pool is stopped and no tasks are left.
+/// </summary>
+/// <param name="pool">The thread pool.</param>
+void runThreadPoolWorker(ThreadPool* pool) {
+    insideThreadPool = true;
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->taskAvailable.wait(lock, [pool] { return pool->stop || !pool->tasks.empty(); });
+            if (pool->tasks.empty()) {
+                return;
+            }
+            task = std::move(pool->tasks.front());
+            pool->tasks.pop_front();
+        }
+        task();
+    }
+}
+
+/// <summary>
+/// Pins a thread to a single CPU.
+/// </summary>
+/// <param name="thread">The thread.</param>
+/// <param name="cpu">The CPU (int) the thread is pinned to.</param>
+/// <returns>True if the thread was pinned, false otherwise.</returns>
+bool pinThread(std::thread& thread, int cpu) {
+    if (cpu >= (int) (sizeof(DWORD_PTR) * 8)) {
+        return false;
+    }
+    return SetThreadAffinityMask((HANDLE) thread.native_handle(), (DWORD_PTR) 1 << cpu) != 0;
+}
+
+/// <summary>
+/// Sets the number of threads the current call of the calling thread may use. This only affects the calling thread, so calls from
+/// different threads with different numbers of cores do not interfere with each other.
+/// </summary>
+/// <param name="cores">Number of cores (int) the call should use, 0 or more than the threads of the pool uses all threads of the pool.</param>
+/// <returns>The number of threads (int) the call uses.</returns>
+int useThreadPool(int cores) {
+    int threads = (int) threadPool()->workers.size() + 1;
+    callThreads = cores <= 0 || cores > threads ? threads : cores;
+    return callThreads;
+}
+
+/// <summary>
+/// Returns the number of threads the current call of the calling thread may use. Tasks of the pool do not start nested parallel work.
+/// </summary>
+/// <returns>The number of threads (int), 1 inside a task of the pool.</returns>
+int poolThreads() {
+    if (insideThreadPool) {
+        return 1;
+    }
+    return callThreads <= 0 ? useThreadPool(0) : callThreads;
+}
+
+/// <summary>
+/// Runs a task with the given number of workers and waits until all of them are done. The calling thread runs worker 0, the other
+/// workers are queued on the thread pool. Inside a task of the pool all workers are run one after the other on the calling thread.
+/// Exceptions of the workers are caught, so they never escape a thread of the pool, and the first one is rethrown on the calling
+/// thread once all workers are done, since the queued workers reference the locals of this call.
+/// </summary>
+/// <param name="threads">The number of workers (int).</param>
+/// <param name="task">The task, called once with every worker index from 0 to threads - 1.</param>
+void runParallel(int threads, const std::function<void(int)>& task) {
+    if (threads <= 1 || insideThreadPool) {
+        for (int t = 0; t < threads; ++t) {
+            task(t);
+        }
+        return;
+    }
+
+    ThreadPool* pool = threadPool();
+    std::mutex doneMutex;
+    std::condition_variable done;
+    int remaining = threads - 1;
+    std::exception_ptr workerError = NULL;                  // The first exception of a queued worker, guarded by doneMutex
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        for (int t = 1; t < threads; ++t) {
+            pool->tasks.push_back([&task, &doneMutex, &done, &remaining, &workerError, t] {
+                std::exception_ptr error = NULL;
+                try {
+                    task(t);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> doneLock(doneMutex);
+                if (error != NULL && workerError == NULL) {
+                    workerError = error;
+                }
+                if (--remaining == 0) {
+                    done.notify_one();
+                }
+            });
+        }
+    }
+    pool->taskAvailable.notify_all();
+
+    // the flag has to be reset and the queued workers have to finish even if worker 0 throws
+    std::exception_ptr callerError = NULL;
+    insideThreadPool = true;
+    try {
+        task(0);
+    } catch (...) {
+        callerError = std::current_exception();
+    }
+    insideThreadPool = false;
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&remaining] { return remaining == 0; });
+
+    if (callerError != NULL) {
+        std::rethrow_exception(callerError);
+    }
+    if (workerError != NULL) {
+        std::rethrow_exception(workerError);
+    }
+}
+
+/// <summary>
+/// Calls body for every index from 0 to count - 1 on the threads of the current call, every thread processes a contiguous range of indices.
+/// </summary>
+/// <param name="count">The number of indices (int).</param>
+/// <param name="body">The loop body, called with the index.</param>
+template <typename F>
+void parallelFor(int count, const F& body) {
+    int threads = poolThreads();
+    if (threads > count) {
+        threads = count;
+    }
+
+    runParallel(threads, [&](int t) {
+        int first = (int) ((int64_t) count * t / threads);
+        int last = (int) ((int64_t) count * (t + 1) / threads);
+        for (int i = first; i < last; ++i) {
+            body(i);
+        }
+    });
+}
+
+/// <summary>
+/// Creates the compressed row-major candidate matrix from the flattened candidate arrays. Since candidatesIdx already contains the
+/// row offsets, the compressed storage is written directly and in parallel instead of inserting every ion one by one.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="candidatesIdx">An integer array that contains indices of where each candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int) of candidatesValues.</param>
+/// <param name="cILength">Length (int) of candidatesIdx.</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <param name="encodingSize">The length (int) of an encoding vector, the number of columns of the candidate matrix.</param>
+/// <returns>A pointer to the candidate matrix with cILength rows and encodingSize columns.</returns>
+template <typename T>
+Eigen::SparseMatrix<T, Eigen::RowMajor>* createCandidateMatrix(int* candidatesValues, int* candidatesIdx,
+                                                               int cVLength, int cILength,
+                                                               bool normalize, int encodingSize) {
+
+    int firstIdx = cILength > 0 ? candidatesIdx[0] : 0;
+
+    auto* m = new Eigen::SparseMatrix<T, Eigen::RowMajor>(cILength, encodingSize);
+    m->resizeNonZeros(cVLength - firstIdx);
+
+    int* outerIndex = m->outerIndexPtr();
+    int* innerIndex = m->innerIndexPtr();
+    T* values = m->valuePtr();
+
+    outerIndex[cILength] = cVLength - firstIdx;
+
+    parallelFor(cILength, [&](int i) {
+        int startIter = candidatesIdx[i];
+        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
+        int nrNonZero = endIter - startIter;
+        int rowStart = startIter - firstIdx;
+        T val = candidateValue<T>(nrNonZero, normalize);
+
+        outerIndex[i] = rowStart;
+        std::copy(candidatesValues + startIter, candidatesValues + endIter, innerIndex + rowStart);
+        std::fill(values + rowStart, values + rowStart + nrNonZero, val);
+
+        // ions of a candidate are usually sorted already, the compressed storage requires sorted column indices
+        if (!std::is_sorted(innerIndex + rowStart, innerIndex + rowStart + nrNonZero)) {
+            std::sort(innerIndex + rowStart, innerIndex + rowStart + nrNonZero);
+        }
+    });
+
+    return m;
+}
+
+/// <summary>
+/// Creates a candidate index segment that takes ownership of a candidate matrix, every row of the matrix is a single candidate.
+/// </summary>
+/// <param name="m">The candidate matrix, has to be compressed.</param>
+/// <param name="firstCandidate">Index (int) of the candidate in the first row.</param>
+/// <returns>The segment, it has to be released with releaseCandidateSegment.</returns>
+template <typename T>
+CandidateSegment createCandidateSegment(Eigen::SparseMatrix<T, Eigen::RowMajor>* m, int firstCandidate) {
+    CandidateSegment segment;
+    segment.rows = (int) m->rows();
+    segment.nnz = (int) m->nonZeros();
+    segment.cols = (int) m->cols();
+    segment.candidates = segment.rows;
+    segment.firstCandidate = firstCandidate;
+    segment.outerIndex = m->outerIndexPtr();
+    segment.innerIndex = m->innerIndexPtr();
+    if constexpr (std::is_same<T, int>::value) {
+        segment.mF32 = NULL;
+        segment.mI32 = m;
+        segment.valuesF32 = NULL;
+        segment.valuesI32 = m->valuePtr();
+    } else {
+        segment.mF32 = m;
+        segment.mI32 = NULL;
+        segment.valuesF32 = m->valuePtr();
+        segment.valuesI32 = NULL;
+    }
+    segment.rowCandidateOffsets = NULL;
+    segment.rowCandidates = NULL;
+    segment.candidateMap = NULL;
+    segment.columnDeltas = NULL;
+    segment.columnDeltaOffsets = NULL;
+    segment.arrays = NULL;
+    return segment;
+}
+
+/// <summary>
+/// Deduplicates a newly built candidate index segment and converts it to the storage layout of the index.
+/// </summary>
+/// <param name="segment">The segment, its candidate matrix has to be owned and its precision has to match T.</param>
+/// <param name="storage">The storage layout (int) of the index, a combination of IndexStorage flags.</param>
+template <typename T>
+void finishCandidateSegment(CandidateSegment& segment, int storage) {
+    deduplicateCandidateSegment<T>(segment);
+    if (storage != CSR_STORAGE) {
+        convertCandidateSegment<T>(segment, storage);
+    }
+}
+
+/// <summary>
+/// Replaces the candidate matrix of an owned candidate index segment by arrays in the given storage layout. Column indices are delta
+/// encoded in parallel if COMPRESSED_COLUMNS is set, values are dropped if PATTERN_ONLY is set. The candidate map of the segment is kept.
+/// </summary>
+/// <param name="segment">The segment, its candidate matrix has to be owned and its precision has to match T.</param>
+/// <param name="storage">The storage layout (int) of the index, a combination of IndexStorage flags.</param>
+template <typename T>
+void convertCandidateSegment(CandidateSegment& segment, int storage) {
+
+    int rows = segment.rows;
+    const int* outerIndex = segment.outerIndex;
+    const int* innerIndex = segment.innerIndex;
+
+    auto* arrays = new SegmentArrays;
+    arrays->outerIndex.assign(outerIndex, outerIndex + rows + 1);
+
+    if ((storage & COMPRESSED_COLUMNS) != 0) {
+        arrays->columnDeltaOffsets.resize(rows + 1);
+        arrays->columnDeltaOffsets[0] = 0;
+
+        parallelFor(rows, [&](int i) {
+            arrays->columnDeltaOffsets[i + 1] = encodeCandidateColumns(innerIndex + outerIndex[i], outerIndex[i + 1] - outerIndex[i], NULL);
+        });
+        std::partial_sum(arrays->columnDeltaOffsets.begin(), arrays->columnDeltaOffsets.end(), arrays->columnDeltaOffsets.begin());
+        arrays->columnDeltas.resize(arrays->columnDeltaOffsets[rows]);
+
+        parallelFor(rows, [&](int i) {
+            encodeCandidateColumns(innerIndex + outerIndex[i], outerIndex[i + 1] - outerIndex[i], arrays->columnDeltas.data() + arrays->columnDeltaOffsets[i]);
+        });
+    } else {
+        arrays->innerIndex.assign(innerIndex, innerIndex + segment.nnz);
+    }
+
+    bool patternOnly = (storage & PATTERN_ONLY) != 0;
+
+    if constexpr (std::is_same<T, int>::value) {
+        if (!patternOnly) {
+            arrays->valuesI32.assign(segment.valuesI32, segment.valuesI32 + segment.nnz);
+        }
+        segment.mI32->resize(0, 0);
+        delete segment.mI32;
+        segment.mI32 = NULL;
+        segment.valuesI32 = patternOnly ? NULL : arrays->valuesI32.data();
+    } else {
+        if (!patternOnly) {
+            arrays->valuesF32.assign(segment.valuesF32, segment.valuesF32 + segment.nnz);
+        }
+        segment.mF32->resize(0, 0);
+        delete segment.mF32;
+        segment.mF32 = NULL;
+        segment.valuesF32 = patternOnly ? NULL : arrays->valuesF32.data();
+    }
+
+    segment.outerIndex = arrays->outerIndex.data();
+    segment.innerIndex = (storage & COMPRESSED_COLUMNS) != 0 ? NULL : arrays->innerIndex.data();
+    segment.columnDeltas = (storage & COMPRESSED_COLUMNS) != 0 ? arrays->columnDeltas.data() : NULL;
+    segment.columnDeltaOffsets = (storage & COMPRESSED_COLUMNS) != 0 ? arrays->columnDeltaOffsets.data() : NULL;
+    segment.arrays = arrays;
+}
+
+/// <summary>
+/// Merges rows with identical ions of an owned candidate index segment into a single row that is shared by all their candidates.
+/// Rows are hashed in parallel and only rows with the same hash are compared. If the segment does not contain identical rows it is
+/// left untouched, otherwise its candidate matrix and candidate map are replaced.
+/// </summary>
+/// <param name="segment">The segment, its candidate matrix has to be owned and its precision has to match T.</param>
+template <typename T>
+void deduplicateCandidateSegment(CandidateSegment& segment) {
+
+    int rows = segment.rows;
+    const int* outerIndex = segment.outerIndex;
+    const int* innerIndex = segment.innerIndex;
+
+    std::vector<std::pair<uint64_t, int>> hashes(rows);
+
+    parallelFor(rows, [&](int i) {
+        hashes[i] = std::make_pair(hashCandidateRow(innerIndex + outerIndex[i], outerIndex[i + 1] - outerIndex[i]), i);
+    });
+
+    std::sort(hashes.begin(), hashes.end());
+
+    // every row is mapped to the first row with identical ions, rows with the same hash are sorted by row
+    std::vector<int> uniqueRow(rows);
+    int nrUnique = rows;
+    for (int i = 0; i < rows;) {
+        int end = i + 1;
+        while (end < rows && hashes[end].first == hashes[i].first) {
+            ++end;
+        }
+        for (int j = i; j < end; ++j) {
+            int row = hashes[j].second;
+            int rowLength = outerIndex[row + 1] - outerIndex[row];
+            uniqueRow[row] = row;
+            for (int k = i; k < j; ++k) {
+                int other = hashes[k].second;
+                if (uniqueRow[other] == other &&
+                    outerIndex[other + 1] - outerIndex[other] == rowLength &&
+                    std::equal(innerIndex + outerIndex[row], innerIndex + outerIndex[row + 1], innerIndex + outerIndex[other])) {
+                    uniqueRow[row] = other;
+                    --nrUnique;
+                    break;
+                }
+            }
+        }
+        i = end;
+    }
+
+    if (nrUnique == rows) {
+        return;
+    }
+
+    // unique rows keep their order, newRow maps every unique row to its row in the deduplicated matrix
+    std::vector<int> newRow(rows);
+    int nextRow = 0;
+    for (int i = 0; i < rows; ++i) {
+        newRow[i] = uniqueRow[i] == i ? nextRow++ : newRow[uniqueRow[i]];
+    }
+
+    auto* m = new Eigen::SparseMatrix<T, Eigen::RowMajor>(nrUnique, segment.cols);
+    auto* mOuterIndex = m->outerIndexPtr();
+    int nnz = 0;
+    for (int i = 0; i < rows; ++i) {
+        if (uniqueRow[i] == i) {
+            mOuterIndex[newRow[i]] = nnz;
+            nnz += outerIndex[i + 1] - outerIndex[i];
+        }
+    }
+    mOuterIndex[nrUnique] = nnz;
+    m->resizeNonZeros(nnz);
+
+    const T* values;
+    if constexpr (std::is_same<T, int>::value) {
+        values = segment.valuesI32;
+    } else {
+        values = segment.valuesF32;
+    }
+
+    parallelFor(rows, [&](int i) {
+        if (uniqueRow[i] == i) {
+            std::copy(innerIndex + outerIndex[i], innerIndex + outerIndex[i + 1], m->innerIndexPtr() + mOuterIndex[newRow[i]]);
+            std::copy(values + outerIndex[i], values + outerIndex[i + 1], m->valuePtr() + mOuterIndex[newRow[i]]);
+        }
+    });
+
+    // the candidates of every row of the deduplicated matrix in ascending order
+    auto* candidateMap = new std::vector<int>(nrUnique + 1 + segment.candidates, 0);
+    int* rowCandidateOffsets = candidateMap->data();
+    int* rowCandidates = candidateMap->data() + nrUnique + 1;
+
+    for (int i = 0; i < rows; ++i) {
+        int nrCandidates = segment.rowCandidateOffsets == NULL ? 1 : segment.rowCandidateOffsets[i + 1] - segment.rowCandidateOffsets[i];
+        rowCandidateOffsets[newRow[i] + 1] += nrCandidates;
+    }
+    std::partial_sum(rowCandidateOffsets, rowCandidateOffsets + nrUnique + 1, rowCandidateOffsets);
+
+    std::vector<int> nextCandidate(rowCandidateOffsets, rowCandidateOffsets + nrUnique);
+    for (int i = 0; i < rows; ++i) {
+        if (segment.rowCandidateOffsets == NULL) {
+            rowCandidates[nextCandidate[newRow[i]]++] = i;
+        } else {
+            for (int j = segment.rowCandidateOffsets[i]; j < segment.rowCandidateOffsets[i + 1]; ++j) {
+                rowCandidates[nextCandidate[newRow[i]]++] = segment.rowCandidates[j];
+            }
+        }
+    }
+
+    if (segment.rowCandidateOffsets != NULL) {
+        parallelFor(nrUnique, [&](int i) {
+            std::sort(rowCandidates + rowCandidateOffsets[i], rowCandidates + rowCandidateOffsets[i + 1]);
+        });
+    }
+
+    int candidates = segment.candidates;
+    int firstCandidate = segment.firstCandidate;
+    releaseCandidateSegment(segment);
+
+    segment = createCandidateSegment(m, firstCandidate);
+    segment.candidates = candidates;
+    segment.candidateMap = candidateMap;
+    segment.rowCandidateOffsets = rowCandidateOffsets;
+    segment.rowCandidates = rowCandidates;
+}
+
+/// <summary>
+/// Copies consecutive segments of a candidate index into a single candidate matrix, rows are copied in parallel. The values of segments without
+/// values are restored from the number of ions of every row.
+/// </summary>
+/// <param name="index">The candidate index, its precision has to match T.</param>
+/// <param name="first">The first segment (size_t) that is copied.</param>
+/// <param name="last">The segment (size_t) behind the last segment that is copied, the segments must not contain more than MAX_SEGMENT_NNZ
+/// ions.</param>
+/// <returns>A pointer to the candidate matrix with the rows of the segments and the encoding size of the index as columns.</returns>
+template <typename T>
+Eigen::SparseMatrix<T, Eigen::RowMajor>* mergeCandidateSegments(const CandidateIndex* index, size_t first, size_t last) {
+
+    int rows = 0;
+    int nnz = 0;
+    for (size_t s = first; s < last; ++s) {
+        rows += index->segments[s].rows;
+        nnz += index->segments[s].nnz;
+    }
+
+    auto* m = new Eigen::SparseMatrix<T, Eigen::RowMajor>(rows, index->geometry.encodingSize);
+    m->resizeNonZeros(nnz);
+
+    int* outerIndex = m->outerIndexPtr();
+    int* innerIndex = m->innerIndexPtr();
+    T* values = m->valuePtr();
+
+    int rowOffset = 0;
+    int nnzOffset = 0;
+    for (size_t s = first; s < last; ++s) {
+        const auto& segment = index->segments[s];
+        const T* segmentValues;
+        if constexpr (std::is_same<T, int>::value) {
+            segmentValues = segment.valuesI32;
+        } else {
+            segmentValues = segment.valuesF32;
+        }
+
+        parallelFor(segment.rows, [&](int i) {
+            int rowStart = segment.outerIndex[i];
+            int rowEnd = segment.outerIndex[i + 1];
+            outerIndex[rowOffset + i] = nnzOffset + rowStart;
+            if (segment.columnDeltas != NULL) {
+                decodeCandidateColumns(segment.columnDeltas + segment.columnDeltaOffsets[i], segment.columnDeltas + segment.columnDeltaOffsets[i + 1], innerIndex + nnzOffset + rowStart);
+            } else {
+                std::copy(segment.innerIndex + rowStart, segment.innerIndex + rowEnd, innerIndex + nnzOffset + rowStart);
+            }
+            if (segmentValues != NULL) {
+                std::copy(segmentValues + rowStart, segmentValues + rowEnd, values + nnzOffset + rowStart);
+            } else {
+                std::fill(values + nnzOffset + rowStart, values + nnzOffset + rowEnd, candidateValue<T>(rowEnd - rowStart, index->normalize));
+            }
+        });
+
+        rowOffset += segment.rows;
+        nnzOffset += segment.nnz;
+    }
+    outerIndex[rowOffset] = nnzOffset;
+
+    return m;
+}
+
+/// <summary>
+/// Combines the candidate maps of consecutive segments of a candidate index into the candidate map of the merged candidate matrix.
+/// </summary>
+/// <param name="index">The candidate index.</param>
+/// <param name="first">The first segment (size_t) that is merged.</param>
+/// <param name="last">The segment (size_t) behind the last segment that is merged.</param>
+/// <returns>A pointer to the row candidate offsets (rows + 1) followed by the row candidates (candidates) relative to the first candidate of
+/// the first segment, NULL if every row of every segment is a single candidate.</returns>
+std::vector<int>* mergeCandidateMaps(const CandidateIndex* index, size_t first, size_t last) {
+
+    int rows = 0;
+    int candidates = 0;
+    bool hasCandidateMap = false;
+    for (size_t s = first; s < last; ++s) {
+        const auto& segment = index->segments[s];
+        rows += segment.rows;
+        candidates += segment.candidates;
+        hasCandidateMap = hasCandidateMap || segment.rowCandidateOffsets != NULL;
+    }
+
+    if (!hasCandidateMap) {
+        return NULL;
+    }
+
+    auto* candidateMap = new std::vector<int>();
+    candidateMap->reserve(rows + 1 + candidates);
+
+    int candidateOffset = 0;
+    for (size_t s = first; s < last; ++s) {
+        const auto& segment = index->segments[s];
+        for (int i = 0; i < segment.rows; ++i) {
+            candidateMap->push_back(candidateOffset + (segment.rowCandidateOffsets == NULL ? i : segment.rowCandidateOffsets[i]));
+        }
+        candidateOffset += segment.candidates;
+    }
+    candidateMap->push_back(candidateOffset);
+
+    int firstCandidate = index->segments[first].firstCandidate;
+    for (size_t s = first; s < last; ++s) {
+        const auto& segment = index->segments[s];
+        for (int i = 0; i < segment.candidates; ++i) {
+            candidateMap->push_back(segment.firstCandidate - firstCandidate + (segment.rowCandidates == NULL ? i : segment.rowCandidates[i]));
+        }
+    }
+
+    return candidateMap;
+}
+
+/// <summary>
+/// Splits flattened candidates or spectra into ranges of consecutive candidates or spectra with at most maxLength values each, so that
+/// the offsets within every range fit into 32 bits.
+/// </summary>
+/// <param name="idx">A 64-bit integer array that contains indices of where each candidate or spectrum starts in the flattened values.</param>
+/// <param name="vLength">Length (int64) of the flattened values.</param>
+/// <param name="iLength">Length (int) of idx.</param>
+/// <param name="maxLength">Largest number (int64) of values of a range.</param>
+/// <returns>The first candidate or spectrum of every range followed by iLength, a single empty range if iLength is 0.</returns>
+/// <exception cref="std::invalid_argument">Thrown if a single candidate or spectrum contains more than maxLength values.</exception>
+std::vector<int> splitOffsetRanges(const int64_t* idx, int64_t vLength, int iLength, int64_t maxLength) {
+    std::vector<int> bounds(1, 0);
+    int64_t rangeStart = iLength > 0 ? idx[0] : 0;
+    for (int i = 0; i < iLength; ++i) {
+        int64_t end = i + 1 == iLength ? vLength : idx[i + 1];
+        if (end - idx[i] > maxLength) {
+            throw std::invalid_argument("A single candidate or spectrum must not contain more than 2^31 - 1 ions or peaks!");
+        }
+        if (end - rangeStart > maxLength) {
+            bounds.push_back(i);
+            rangeStart = idx[i];
+        }
+    }
+    bounds.push_back(iLength);
+    return bounds;
+}
+
+/// <summary>
+/// Appends candidates to a candidate index as one new segment per range of segmentBounds, the candidates get the indices following the
+/// existing candidates of the index. The 64-bit offsets of every segment are rebased to 32-bit offsets relative to its first ion.
+/// </summary>
+/// <param name="index">The candidate index.</param>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all appended candidates flattened.</param>
+/// <param name="candidatesIdx">A 64-bit integer array that contains indices of where each appended candidate starts in candidatesValues.</param>
+/// <param name="cVLength">Length (int64) of candidatesValues.</param>
+/// <param name="segmentBounds">The first candidate of every segment followed by the number of appended candidates, see splitOffsetRanges.</param>
+void appendCandidateSegments(CandidateIndex* index, int* candidatesValues, const int64_t* candidatesIdx, int64_t cVLength, const std::vector<int>& segmentBounds) {
+    int cILength = segmentBounds.back();
+    std::vector<int> segmentIdx;
+
+    for (size_t s = 0; s + 1 < segmentBounds.size(); ++s) {
+        int first = segmentBounds[s];
+        int rows = segmentBounds[s + 1] - first;
+        int64_t start = rows > 0 ? candidatesIdx[first] : 0;
+        int64_t end = rows == 0 ? start : segmentBounds[s + 1] == cILength ? cVLength : candidatesIdx[segmentBounds[s + 1]];
+
+        segmentIdx.resize(rows);
+        for (int i = 0; i < rows; ++i) {
+            segmentIdx[i] = (int) (candidatesIdx[first + i] - start);
+        }
+
+        if (index->useInt) {
+            index->segments.push_back(createCandidateSegment(createCandidateMatrix<int>(candidatesValues + start, segmentIdx.data(), (int) (end - start), rows, index->normalize, index->geometry.encodingSize), index->cILength));
+            finishCandidateSegment<int>(index->segments.back(), index->storage);
+        } else {
+            index->segments.push_back(createCandidateSegment(createCandidateMatrix<float>(candidatesValues + start, segmentIdx.data(), (int) (end - start), rows, index->normalize, index->geometry.encodingSize), index->cILength));
+            finishCandidateSegment<float>(index->segments.back(), index->storage);
+        }
+
+        index->cILength += rows;
+        index->nnz += index->segments.back().nnz;
+    }
+}
+
+/// <summary>
+/// Encodes the collected candidates of a candidate index builder as new segments of its index and clears the collected candidates.
+/// </summary>
+/// <param name="builder">The candidate index builder.</param>
+void flushCandidateIndexBuilder(CandidateIndexBuilder* builder) {
+    int64_t vLength = (int64_t) builder->pendingValues.size();
+    int iLength = (int) builder->pendingIdx.size();
+
+    std::vector<int> segmentBounds = splitOffsetRanges(builder->pendingIdx.data(), vLength, iLength, MAX_SEGMENT_NNZ);
+    appendCandidateSegments(builder->index, builder->pendingValues.data(), builder->pendingIdx.data(), vLength, segmentBounds);
+
+    builder->pendingValues.clear();
+    builder->pendingIdx.clear();
+}
+
+/// <summary>
+/// Frees the candidate matrix, arrays and candidate map owned by a candidate index segment, memory mapped segments are left untouched.
+/// </summary>
+/// <param name="segment">The segment.</param>
+void releaseCandidateSegment(CandidateSegment& segment) {
+
+    if (segment.mF32 != NULL) {
+        segment.mF32->resize(0, 0);
+        delete segment.mF32;
+        segment.mF32 = NULL;
+    }
+
+    if (segment.mI32 != NULL) {
+        segment.mI32->resize(0, 0);
+        delete segment.mI32;
+        segment.mI32 = NULL;
+    }
+
+    if (segment.candidateMap != NULL) {
+        delete segment.candidateMap;
+        segment.candidateMap = NULL;
+    }
+
+    if (segment.arrays != NULL) {
+        delete segment.arrays;
+        segment.arrays = NULL;
+    }
+}
+
+/// <summary>
+/// Returns a view of an owned candidate matrix.
+/// </summary>
+/// <param name="m">The candidate matrix, has to be compressed.</param>
+/// <param name="normalize">If the candidate vectors of the matrix are normalized to sum(elements) = 1 (bool).</param>
+/// <returns>A compressed row-major view of the candidate matrix consisting of a single block.</returns>
+template <typename T>
+CandidateMatrices<T> candidateMatrixView(const Eigen::SparseMatrix<T, Eigen::RowMajor>& m, bool normalize) {
+    return CandidateMatrices<T>{CandidateBlock<T>{CandidateMatrix<T>(m.rows(), m.cols(), m.nonZeros(), m.outerIndexPtr(), m.innerIndexPtr(), m.valuePtr()), 0, NULL, NULL, NULL, NULL, normalize}};
+}
+
+/// <summary>
+/// Returns a view of the candidate matrix of a candidate index.
+/// </summary>
+/// <param name="index">The candidate index, its precision has to match T.</param>
+/// <returns>A compressed row-major view of every segment of the candidate matrix.</returns>
+template <typename T>
+CandidateMatrices<T> candidateMatrixView(const CandidateIndex* index) {
+    CandidateMatrices<T> m;
+    m.reserve(index->segments.size());
+    for (const auto& segment : index->segments) {
+        if constexpr (std::is_same<T, int>::value) {
+            m.push_back(CandidateBlock<T>{CandidateMatrix<T>(segment.rows, segment.cols, segment.nnz, segment.outerIndex, segment.innerIndex, segment.valuesI32),
+                                          segment.firstCandidate, segment.rowCandidateOffsets, segment.rowCandidates,
+                                          segment.columnDeltas, segment.columnDeltaOffsets, index->normalize});
+        } else {
+            m.push_back(CandidateBlock<T>{CandidateMatrix<T>(segment.rows, segment.cols, segment.nnz, segment.outerIndex, segment.innerIndex, segment.valuesF32),
+                                          segment.firstCandidate, segment.rowCandidateOffsets, segment.rowCandidates,
+                                          segment.columnDeltas, segment.columnDeltaOffsets, index->normalize});
+        }
+    }
+    return m;
+}
+
+/// <summary>
+/// Returns the total number of rows of a blocked candidate matrix.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <returns>The number of rows (int) of all blocks.</returns>
+template <typename T>
+int candidateMatrixRows(const CandidateMatrices<T>& m) {
+    int rows = 0;
+    for (const auto& block : m) {
+        rows += (int) block.m.rows();
+    }
+    return rows;
+}
+
+/// <summary>
+/// Writes the top n candidates of a spectrum given the rows of a blocked candidate matrix sorted by score. Rows shared by identical
+/// candidates are expanded to all of their candidates, candidates with equal scores are ranked by ascending candidate index like
+/// without shared rows. Shared rows are ordered by their first candidate, so of rows with equal scores only the first n rows can hold
+/// one of the top n candidates.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="idx">The rows of the candidate matrix sorted by descending score and ascending row.</param>
+/// <param name="topScores">The scores of the rows in idx.</param>
+/// <param name="count">Number (int) of rows in idx, has to be n or all rows of the candidate matrix.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="result">An integer array of length n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length n that the scores of the top n candidates are written to, NULL if scores are not needed.</param>
+template <typename T>
+void expandTopCandidates(const CandidateMatrices<T>& m, const int* idx, const T* topScores, int count, int n, int* result, T* scores) {
+    if (m.size() == 1 && m[0].rowCandidateOffsets == NULL && m[0].firstCandidate == 0) {
+        std::copy(idx, idx + n, result);
+        if (scores != NULL) {
+            std::copy(topScores, topScores + n, scores);
+        }
+        return;
+    }
+
+    // the block of a row and the range of its candidates in rowCandidates, a row without shared candidates is its own range
+    auto locateRow = [&m](int row, size_t& b, int& first, int& last) {
+        b = 0;
+        while (row >= m[b].m.rows()) {
+            row -= (int) m[b].m.rows();
+            ++b;
+        }
+        first = m[b].rowCandidateOffsets == NULL ? row : m[b].rowCandidateOffsets[row];
+        last = m[b].rowCandidateOffsets == NULL ? row + 1 : m[b].rowCandidateOffsets[row + 1];
+    };
+    auto candidate = [&m](size_t b, int k) {
+        return m[b].firstCandidate + (m[b].rowCandidates == NULL ? k : m[b].rowCandidates[k]);
+    };
+
+    std::vector<int> tied;
+    int j = 0;
+    for (int r = 0; r < count && j < n;) {
+        size_t b;
+        int first, last;
+        locateRow(idx[r], b, first, last);
+        bool shared = last - first > 1;
+        int end = r + 1;
+        while (end < count && end - r < n - j && topScores[end] == topScores[r]) {
+            size_t otherBlock;
+            int otherFirst, otherLast;
+            locateRow(idx[end], otherBlock, otherFirst, otherLast);
+            shared = shared || otherLast - otherFirst > 1;
+            ++end;
+        }
+
+        if (!shared) {
+            // rows of single candidates are ordered like their candidates
+            for (int t = r; t < end; ++t) {
+                locateRow(idx[t], b, first, last);
+                if (scores != NULL) {
+                    scores[j] = topScores[t];
+                }
+                result[j++] = candidate(b, first);
+            }
+        } else if (end - r == 1) {
+            for (int k = first; k < last && j < n; ++k) {
+                if (scores != NULL) {
+                    scores[j] = topScores[r];
+                }
+                result[j++] = candidate(b, k);
+            }
+        } else {
+            // the candidates of tied rows interleave, so they are merged by candidate index
+            tied.clear();
+            for (int t = r; t < end; ++t) {
+                locateRow(idx[t], b, first, last);
+                for (int k = first; k < last; ++k) {
+                    tied.push_back(candidate(b, k));
+                }
+            }
+            int take = n - j < (int) tied.size() ? n - j : (int) tied.size();
+            std::partial_sort(tied.begin(), tied.begin() + take, tied.end());
+            for (int t = 0; t < take; ++t) {
+                if (scores != NULL) {
+                    scores[j] = topScores[r];
+                }
+                result[j++] = tied[t];
+            }
+        }
+        r = end;
+    }
+}
+
+/// <summary>
+/// Multiplies a blocked candidate matrix with a spectrum vector or matrix, the product of every block is written to the rows of the
+/// result that correspond to the candidates of the block. Blocks with delta encoded column indices or without values can only be
+/// multiplied with a dense spectrum vector. The rows of every block are split among the threads of the current call.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="query">The encoded spectrum vector or matrix.</param>
+/// <param name="result">The result vector or matrix with one row per candidate.</param>
+template <typename T, typename Q, typename R>
+void multiplyCandidateMatrices(const CandidateMatrices<T>& m, const Q& query, R& result) {
+    int rowOffset = 0;
+    for (const auto& block : m) {
+        if (block.columnDeltas == NULL && block.m.valuePtr() != NULL) {
+            int rows = (int) block.m.rows();
+            int nrThreads = poolThreads();
+            const int* outerIndex = block.m.outerIndexPtr();
+
+            // every thread multiplies a contiguous range of rows that shares the arrays of the block
+            parallelFor(nrThreads, [&](int t) {
+                int first = (int) ((int64_t) rows * t / nrThreads);
+                int last = (int) ((int64_t) rows * (t + 1) / nrThreads);
+                CandidateMatrix<T> rowRange(last - first, block.m.cols(), outerIndex[last] - outerIndex[first], outerIndex + first, block.m.innerIndexPtr(), block.m.valuePtr());
+                if constexpr (std::is_base_of<Eigen::MatrixBase<Q>, Q>::value) {
+                    result.middleRows(rowOffset + first, last - first).noalias() = rowRange * query;
+                } else {
+                    result.middleRows(rowOffset + first, last - first) = Eigen::Product(rowRange, query);
+                }
+            });
+        } else if constexpr (std::is_same<Q, Eigen::Vector<T, Eigen::Dynamic>>::value) {
+            multiplyCandidateBlock(block, query.data(), result.data() + rowOffset);
+        } else {
+            throw std::invalid_argument("Delta encoded column indices or blocks without values can only be multiplied with a dense vector!");
+        }
+        rowOffset += (int) block.m.rows();
+    }
+}
+
+/// <summary>
+/// Multiplies the rows of a candidate block with delta encoded column indices or without values with a dense spectrum vector, rows are
+/// processed in parallel. Rows without values are scored with the value of the row for every ion, so that f32 scores are bit-identical
+/// to the scores of the same rows with values.
+/// </summary>
+/// <param name="block">The candidate block, its column indices have to be delta encoded or it must not have values.</param>
+/// <param name="v">The dense spectrum vector, its length is the number of columns of the block.</param>
+/// <param name="result">An array that the score of every row of the block is written to.</param>
+template <typename T>
+void multiplyCandidateBlock(const CandidateBlock<T>& block, const T* v, T* result) {
+    int rows = (int) block.m.rows();
+    const int* outerIndex = block.m.outerIndexPtr();
+    const int* innerIndex = block.m.innerIndexPtr();
+    const T* values = block.m.valuePtr();
+
+    parallelFor(rows, [&](int i) {
+        int rowLength = outerIndex[i + 1] - outerIndex[i];
+        if (values != NULL) {
+            result[i] = compressedRowProduct<T, true>(block.columnDeltas + block.columnDeltaOffsets[i], block.columnDeltas + block.columnDeltaOffsets[i + 1], values + outerIndex[i], 0, v);
+        } else if (rowLength == 0) {
+            result[i] = 0;
+        } else if (block.columnDeltas != NULL) {
+            result[i] = compressedRowProduct<T, false>(block.columnDeltas + block.columnDeltaOffsets[i], block.columnDeltas + block.columnDeltaOffsets[i + 1], NULL, candidateValue<T>(rowLength, block.normalize), v);
+        } else {
+            result[i] = patternRowProduct(innerIndex + outerIndex[i], rowLength, candidateValue<T>(rowLength, block.normalize), v);
+        }
+    });
+}
+
+/// <summary>
+/// Calculates the dot product of a row with delta encoded column indices and a dense spectrum vector. Runs of eight deltas without
+/// escape are decoded with SSE2 prefix sums, the spectrum vector is gathered with AVX2 if available. Escaped deltas are decoded one by one.
+/// f32 products are added one by one in column order like Eigen sums the rows of a CSR candidate matrix, so both give the same scores.
+/// </summary>
+/// <param name="deltas">Pointer to the first column delta of the row.</param>
+/// <param name="end">Pointer behind the last column delta of the row.</param>
+/// <param name="values">Pointer to the value of the first ion of the row, ignored if hasValues is false.</param>
+/// <param name="value">The value of every ion of the row, ignored if hasValues is true.</param>
+/// <param name="v">The dense spectrum vector, its length is the number of columns of the block.</param>
+/// <returns>The score of the row.</returns>
+template <typename T, bool hasValues>
+T compressedRowProduct(const uint16_t* deltas, const uint16_t* end, const T* values, T value, const T* v) {
+    T sum = 0;
+    int column = 0;
+
+#ifdef USE_SSE2
+    const __m128i escape = _mm_set1_epi16((short) COLUMN_DELTA_ESCAPE);
+    const __m128i zero = _mm_setzero_si128();
+#ifdef __AVX2__
+    __m256i sumI32 = _mm256_setzero_si256();
+    alignas(32) float products[8];
+#else
+    alignas(16) int columns[8];
+#endif
+#endif
+
+    while (deltas < end) {
+#ifdef USE_SSE2
+        if (end - deltas >= 8) {
+            __m128i d = _mm_loadu_si128((const __m128i*) deltas);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(d, escape)) == 0) {
+
+                // widen to 32 bits and calculate the inclusive prefix sum of both halves
+                __m128i lo = _mm_unpacklo_epi16(d, zero);
+                __m128i hi = _mm_unpackhi_epi16(d, zero);
+                lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 4));
+                lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 8));
+                hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 4));
+                hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 8));
+                lo = _mm_add_epi32(lo, _mm_set1_epi32(column));
+                hi = _mm_add_epi32(hi, _mm_shuffle_epi32(lo, 0xFF));
+                column = _mm_cvtsi128_si32(_mm_shuffle_epi32(hi, 0xFF));
+
+#ifdef __AVX2__
+                __m256i idx = _mm256_set_m128i(hi, lo);
+                if constexpr (std::is_same<T, int>::value) {
+                    __m256i gathered = _mm256_i32gather_epi32(v, idx, 4);
+                    __m256i factors = hasValues ? _mm256_loadu_si256((const __m256i*) values) : _mm256_set1_epi32(value);
+                    sumI32 = _mm256_add_epi32(sumI32, _mm256_mullo_epi32(gathered, factors));
+                } else {
+                    __m256 gathered = _mm256_i32gather_ps(v, idx, 4);
+                    __m256 factors = hasValues ? _mm256_loadu_ps(values) : _mm256_set1_ps(value);
+                    _mm256_store_ps(products, _mm256_mul_ps(factors, gathered));
+                    for (int k = 0; k < 8; ++k) {
+                        sum += products[k];
+                    }
+                }
+#else
+                _mm_store_si128((__m128i*) columns, lo);
+                _mm_store_si128((__m128i*) (columns + 4), hi);
+                for (int k = 0; k < 8; ++k) {
+                    sum += (hasValues ? values[k] : value) * v[columns[k]];
+                }
+#endif
+
+                deltas += 8;
+                if constexpr (hasValues) {
+                    values += 8;
+                }
+                continue;
+            }
+        }
+#endif
+
+        if (*deltas == COLUMN_DELTA_ESCAPE) {
+            column = (int) deltas[1] | ((int) deltas[2] << 16);
+            deltas += 3;
+        } else {
+            column += *deltas;
+            deltas += 1;
+        }
+        if constexpr (hasValues) {
+            sum += *values * v[column];
+            ++values;
+        } else {
+            sum += value * v[column];
+        }
+    }
+
+#if defined(USE_SSE2) && defined(__AVX2__)
+    if constexpr (std::is_same<T, int>::value) {
+        alignas(32) int lanes[8];
+        _mm256_store_si256((__m256i*) lanes, sumI32);
+        for (int k = 0; k < 8; ++k) {
+            sum += lanes[k];
+        }
+    }
+#endif
+
+    return sum;
+}
+
+/// <summary>
+/// Calculates the dot product of a row without values and a dense spectrum vector, every ion of the row has the same value. The spectrum
+/// vector is gathered eight columns at a time with AVX2 if available. i32 sums are exact and scaled once, f32 products are scaled ion by
+/// ion and added in column order instead of in AVX2 lanes, as the same row with values would be.
+/// </summary>
+/// <param name="columns">Pointer to the first column index of the row.</param>
+/// <param name="length">Number (int) of column indices of the row.</param>
+/// <param name="value">The value of every ion of the row.</param>
+/// <param name="v">The dense spectrum vector, its length is the number of columns of the block.</param>
+/// <returns>The score of the row.</returns>
+template <typename T>
+T patternRowProduct(const int* columns, int length, T value, const T* v) {
+    T sum = 0;
+    int k = 0;
+
+    if constexpr (std::is_same<T, int>::value) {
+#if defined(USE_SSE2) && defined(__AVX2__)
+        alignas(32) int lanes[8];
+        __m256i sumI32 = _mm256_setzero_si256();
+        for (; k + 8 <= length; k += 8) {
+            sumI32 = _mm256_add_epi32(sumI32, _mm256_i32gather_epi32(v, _mm256_loadu_si256((const __m256i*) (columns + k)), 4));
+        }
+        _mm256_store_si256((__m256i*) lanes, sumI32);
+        for (int j = 0; j < 8; ++j) {
+            sum += lanes[j];
+        }
+#endif
+        for (; k < length; ++k) {
+            sum += v[columns[k]];
+        }
+        return sum * value;
+    } else {
+#if defined(USE_SSE2) && defined(__AVX2__)
+        alignas(32) float products[8];
+        const __m256 factors = _mm256_set1_ps(value);
+        for (; k + 8 <= length; k += 8) {
+            _mm256_store_ps(products, _mm256_mul_ps(factors, _mm256_i32gather_ps(v, _mm256_loadu_si256((const __m256i*) (columns + k)), 4)));
+            for (int j = 0; j < 8; ++j) {
+                sum += products[j];
+            }
+        }
+#endif
+        for (; k < length; ++k) {
+            sum += value * v[columns[k]];
+        }
+        return sum;
+    }
+}
+
+/// <summary>
+/// Counts the column indices of a row whose bins are set in a binary spectrum bitset. The words of eight columns are gathered at a time
+/// and their bits are tested with AVX2 if available.
+/// </summary>
+/// <param name="columns">Pointer to the first column index of the row.</param>
+/// <param name="length">Number (int) of column indices of the row.</param>
+/// <param name="bits">The binary spectrum bitset, bin k is bit k % 32 of bits[k / 32].</param>
+/// <returns>The number (int) of column indices whose bins are set.</returns>
+int bitsetRowMatches(const int* columns, int length, const uint32_t* bits) {
+    int matches = 0;
+    int k = 0;
+
+#if defined(USE_SSE2) && defined(__AVX2__)
+    alignas(32) int lanes[8];
+    const __m256i bitMask = _mm256_set1_epi32(31);
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i counts = _mm256_setzero_si256();
+    for (; k + 8 <= length; k += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i*) (columns + k));
+        __m256i words = _mm256_i32gather_epi32((const int*) bits, _mm256_srli_epi32(c, 5), 4);
+        counts = _mm256_add_epi32(counts, _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(c, bitMask)), one));
+    }
+    _mm256_store_si256((__m256i*) lanes, counts);
+    for (int j = 0; j < 8; ++j) {
+        matches += lanes[j];
+    }
+#endif
+
+    for (; k < length; ++k) {
+        matches += (bits[columns[k] >> 5] >> (columns[k] & 31)) & 1;
+    }
+
+    return matches;
+}
+
+/// <summary>
+/// Returns if a (score, row) pair is ranked before another one, higher scores are ranked first and equal scores by ascending row.
+/// </summary>
+/// <param name="a">The first (score, row) pair.</param>
+/// <param name="b">The second (score, row) pair.</param>
+/// <returns>True if a is ranked before b.</returns>
+template <typename T>
+bool rankedBefore(const std::pair<T, int>& a, const std::pair<T, int>& b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+/// <summary>
+/// Selects the k best rows of a score vector sorted by descending score, equal scores are sorted by ascending row. Small k are selected
+/// with a bounded heap, larger k with a radix selection (i32) or nth_element (f32). The buffers of the selector are reused.
+/// </summary>
+/// <param name="scores">The score of every row.</param>
+/// <param name="rows">The rows that should be considered, NULL if all rows from 0 to count - 1 should be considered.</param>
+/// <param name="count">Number (int) of rows that should be considered.</param>
+/// <param name="k">How many rows (int) should be selected, at most count rows are selected.</param>
+/// <param name="selector">The reusable buffers of the selection, the scores of the selected rows are written to scores.</param>
+/// <returns>A pointer to the min(k, count) selected rows, valid until the selector is used again.</returns>
+template <typename T>
+const int* selectTopRows(const T* scores, const int* rows, int count, int k, TopRowSelector<T>& selector) {
+    k = k < count ? k : count;
+    selector.top.clear();
+
+    if (k > 0) {
+        if (k <= TOP_ROWS_HEAP_LIMIT) {
+            heapTopRows(scores, rows, count, k, selector);
+        } else if constexpr (std::is_same<T, int>::value) {
+            radixTopRows(scores, rows, count, k, selector);
+        } else {
+            auto& candidates = selector.candidates;
+            if (rows != NULL) {
+                candidates.assign(rows, rows + count);
+            } else {
+                candidates.resize(count);
+                std::iota(candidates.begin(), candidates.end(), 0);
+            }
+            std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end(), [&](int a, int b) {
+                return rankedBefore(std::make_pair(scores[a], a), std::make_pair(scores[b], b));
+            });
+            for (int j = 0; j < k; ++j) {
+                selector.top.push_back(std::make_pair(scores[candidates[j]], candidates[j]));
+            }
+        }
+    }
+
+    std::sort(selector.top.begin(), selector.top.end(), rankedBefore<T>);
+
+    selector.rows.resize(k);
+    selector.scores.resize(k);
+    for (int j = 0; j < k; ++j) {
+        selector.rows[j] = selector.top[j].second;
+        selector.scores[j] = selector.top[j].first;
+    }
+    return selector.rows.data();
+}
+
+/// <summary>
+/// Selects the k best rows of a score vector with a bounded heap whose front is the worst selected row. If all rows are considered in
+/// ascending order, a later row only enters the heap with a strictly higher score, so blocks of eight scores that are not above the
+/// worst selected score are skipped with SSE2.
+/// </summary>
+/// <param name="scores">The score of every row.</param>
+/// <param name="rows">The rows that should be considered, NULL if all rows from 0 to count - 1 should be considered.</param>
+/// <param name="count">Number (int) of rows that should be considered.</param>
+/// <param name="k">How many rows (int) should be selected, has to be between 1 and count.</param>
+/// <param name="selector">The reusable buffers of the selection, the selected (score, row) pairs are written to top.</param>
+template <typename T>
+void heapTopRows(const T* scores, const int* rows, int count, int k, TopRowSelector<T>& selector) {
+    auto& top = selector.top;
+
+    for (int j = 0; j < k; ++j) {
+        int row = rows == NULL ? j : rows[j];
+        top.push_back(std::make_pair(scores[row], row));
+    }
+    std::make_heap(top.begin(), top.end(), rankedBefore<T>);
+
+    int j = k;
+    while (j < count) {
+#ifdef USE_SSE2
+        if (rows == NULL && count - j >= 8) {
+            int mask;
+            if constexpr (std::is_same<T, int>::value) {
+                __m128i threshold = _mm_set1_epi32(top.front().first);
+                __m128i lo = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*) (scores + j)), threshold);
+                __m128i hi = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*) (scores + j + 4)), threshold);
+                mask = _mm_movemask_epi8(_mm_or_si128(lo, hi));
+            } else {
+                __m128 threshold = _mm_set1_ps(top.front().first);
+                __m128 lo = _mm_cmpgt_ps(_mm_loadu_ps(scores + j), threshold);
+                __m128 hi = _mm_cmpgt_ps(_mm_loadu_ps(scores + j + 4), threshold);
+                mask = _mm_movemask_ps(_mm_or_ps(lo, hi));
+            }
+            if (mask == 0) {
+                j += 8;
+                continue;
+            }
+        }
+#endif
+
+        int row = rows == NULL ? j : rows[j];
+        auto current = std::make_pair(scores[row], row);
+        if (rankedBefore(current, top.front())) {
+            std::pop_heap(top.begin(), top.end(), rankedBefore<T>);
+            top.back() = current;
+            std::push_heap(top.begin(), top.end(), rankedBefore<T>);
+        }
+        ++j;
+    }
+}
+
+/// <summary>
+/// Adds consecutive rows of a score vector to a bounded heap of the k best rows seen so far, whose front is the worst selected row. The
+/// heap is kept between calls, so the best rows of a score vector that is computed in tiles of rows can be selected tile by tile. Once
+/// the heap is full, blocks of eight scores that are not above the worst selected score are skipped with SSE2.
+/// </summary>
+/// <param name="scores">The scores of the rows of the tile.</param>
+/// <param name="count">Number (int) of rows of the tile.</param>
+/// <param name="firstRow">The row (int) of the first score of the tile.</param>
+/// <param name="k">How many rows (int) should be selected.</param>
+/// <param name="top">The heap of selected (score, row) pairs, ordered with rankedBefore.</param>
+template <typename T>
+void streamTopRows(const T* scores, int count, int firstRow, int k, std::vector<std::pair<T, int>>& top) {
+    int j = 0;
+    for (; j < count && (int) top.size() < k; ++j) {
+        top.push_back(std::make_pair(scores[j], firstRow + j));
+        std::push_heap(top.begin(), top.end(), rankedBefore<T>);
+    }
+
+    while (j < count) {
+#ifdef USE_SSE2
+        if (count - j >= 8) {
+            int mask;
+            if constexpr (std::is_same<T, int>::value) {
+                __m128i threshold = _mm_set1_epi32(top.front().first);
+                __m128i lo = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*) (scores + j)), threshold);
+                __m128i hi = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*) (scores + j + 4)), threshold);
+                mask = _mm_movemask_epi8(_mm_or_si128(lo, hi));
+            } else {
+                __m128 threshold = _mm_set1_ps(top.front().first);
+                __m128 lo = _mm_cmpgt_ps(_mm_loadu_ps(scores + j), threshold);
+                __m128 hi = _mm_cmpgt_ps(_mm_loadu_ps(scores + j + 4), threshold);
+                mask = _mm_movemask_ps(_mm_or_ps(lo, hi));
+            }
+            if (mask == 0) {
+                j += 8;
+                continue;
+            }
+        }
+#endif
+
+        auto current = std::make_pair(scores[j], firstRow + j);
+        if (rankedBefore(current, top.front())) {
+            std::pop_heap(top.begin(), top.end(), rankedBefore<T>);
+            top.back() = current;
+            std::push_heap(top.begin(), top.end(), rankedBefore<T>);
+        }
+        ++j;
+    }
+}
+
+/// <summary>
+/// Splits a blocked candidate matrix into tiles of consecutive rows that are scored by one thread at a time. Every tile is given by its
+/// block, its first row within the block and its first row within the candidate matrix.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix, they must have uncompressed column indices and values.</param>
+/// <param name="tileRows">Number of rows (int) of every tile, the last tile of a block may be shorter.</param>
+/// <returns>The tiles of all blocks in the order of the rows.</returns>
+/// <exception cref="std::invalid_argument">Thrown if a block has delta encoded column indices or no values.</exception>
+template <typename T>
+std::vector<std::array<int, 3>> candidateTiles(const CandidateMatrices<T>& m, int tileRows) {
+    std::vector<std::array<int, 3>> tiles;
+    int rowOffset = 0;
+    for (size_t b = 0; b < m.size(); ++b) {
+        if (m[b].columnDeltas != NULL || m[b].m.valuePtr() == NULL) {
+            throw std::invalid_argument("Delta encoded column indices or blocks without values can only be multiplied with a dense vector!");
+        }
+        for (int first = 0; first < (int) m[b].m.rows(); first += tileRows) {
+            tiles.push_back({(int) b, first, rowOffset + first});
+        }
+        rowOffset += (int) m[b].m.rows();
+    }
+    return tiles;
+}
+
+/// <summary>
+/// Merges the heaps of the best rows of a spectrum that the threads filled with streamTopRows and writes the top n candidates of the
+/// spectrum. The heaps of the spectrum are emptied for the next batch.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="threadTop">The heaps of every thread and spectrum of the batch.</param>
+/// <param name="s">The spectrum (int) within the batch.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="selector">The reusable buffers of the selection.</param>
+/// <param name="result">An integer array of length n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length n that the scores of the top n candidates are written to, NULL if scores are not needed.</param>
+template <typename T>
+void expandThreadTopRows(const CandidateMatrices<T>& m, std::vector<std::vector<std::vector<std::pair<T, int>>>>& threadTop, int s, int n,
+                         TopRowSelector<T>& selector, int* result, T* scores) {
+    auto& top = selector.top;
+    top.clear();
+    for (auto& heap : threadTop) {
+        top.insert(top.end(), heap[s].begin(), heap[s].end());
+        heap[s].clear();
+    }
+    int k = n < (int) top.size() ? n : (int) top.size();
+    std::partial_sort(top.begin(), top.begin() + k, top.end(), rankedBefore<T>);
+
+    selector.rows.resize(k);
+    selector.scores.resize(k);
+    for (int j = 0; j < k; ++j) {
+        selector.rows[j] = top[j].second;
+        selector.scores[j] = top[j].first;
+    }
+    expandTopCandidates(m, selector.rows.data(), selector.scores.data(), k, n, result, scores);
+}
+
+/// <summary>
+/// Selects the k best rows of an i32 score vector with a two pass radix selection over the high and low 16 bits of the scores. The
+/// selection finds the k-th best score, all rows with a higher score and the rows with the k-th best score with the lowest rows are
+/// selected.
+/// </summary>
+/// <param name="scores">The score of every row.</param>
+/// <param name="rows">The rows that should be considered, NULL if all rows from 0 to count - 1 should be considered.</param>
+/// <param name="count">Number (int) of rows that should be considered.</param>
+/// <param name="k">How many rows (int) should be selected, has to be between 1 and count.</param>
+/// <param name="selector">The reusable buffers of the selection, the selected (score, row) pairs are written to top.</param>
+template <typename T>
+void radixTopRows(const T* scores, const int* rows, int count, int k, TopRowSelector<T>& selector) {
+    auto& histogram = selector.histogram;
+
+    // flipping the sign bit maps the i32 scores to u32 keys with the same order
+    auto key = [&](int j) { return (uint32_t) scores[rows == NULL ? j : rows[j]] ^ 0x80000000u; };
+
+    histogram.assign(65536, 0);
+    for (int j = 0; j < count; ++j) {
+        ++histogram[key(j) >> 16];
+    }
+    int above = 0;
+    uint32_t high = 65535;
+    while (above + (int) histogram[high] < k) {
+        above += histogram[high];
+        --high;
+    }
+
+    histogram.assign(65536, 0);
+    for (int j = 0; j < count; ++j) {
+        uint32_t current = key(j);
+        if ((current >> 16) == high) {
+            ++histogram[current & 0xFFFF];
+        }
+    }
+    uint32_t low = 65535;
+    while (above + (int) histogram[low] < k) {
+        above += histogram[low];
+        --low;
+    }
+
+    // above rows have a higher key than the k-th best key, the remaining rows are taken from the rows with the k-th best key
+    uint32_t threshold = (high << 16) | low;
+    auto& equal = selector.candidates;
+    equal.clear();
+    for (int j = 0; j < count; ++j) {
+        uint32_t current = key(j);
+        int row = rows == NULL ? j : rows[j];
+        if (current > threshold) {
+            selector.top.push_back(std::make_pair(scores[row], row));
+        } else if (current == threshold) {
+            equal.push_back(row);
+        }
+    }
+
+    int nrEqual = k - above;
+    if (rows != NULL) {
+        std::nth_element(equal.begin(), equal.begin() + (nrEqual - 1), equal.end());
+    }
+    for (int j = 0; j < nrEqual; ++j) {
+        selector.top.push_back(std::make_pair(scores[equal[j]], equal[j]));
+    }
+}
+
+/// <summary>
+/// Returns the column indices of a row of a candidate block, delta encoded column indices are decoded into a buffer.
+/// </summary>
+/// <param name="block">The candidate block.</param>
+/// <param name="row">The row (int) in the block.</param>
+/// <param name="buffer">A buffer that delta encoded column indices are decoded to, it is resized if necessary.</param>
+/// <returns>A pointer to the column indices of the row, there are outerIndex[row + 1] - outerIndex[row] of them.</returns>
+template <typename T>
+const int* candidateRowColumns(const CandidateBlock<T>& block, int row, std::vector<int>& buffer) {
+    const int* outerIndex = block.m.outerIndexPtr();
+    if (block.columnDeltas == NULL) {
+        return block.m.innerIndexPtr() + outerIndex[row];
+    }
+
+    buffer.resize(outerIndex[row + 1] - outerIndex[row]);
+    decodeCandidateColumns(block.columnDeltas + block.columnDeltaOffsets[row], block.columnDeltas + block.columnDeltaOffsets[row + 1], buffer.data());
+    return buffer.data();
+}
+
+/// <summary>
+/// Creates the inverted index of a blocked candidate matrix. Every thread counts and fills a contiguous range of columns while visiting
+/// all rows in ascending order, so the rows of every column are sorted without sorting and the counts of all columns are only stored
+/// once instead of once per thread. The ions of a row in the range of a thread are found by binary search, since the column indices of
+/// every row are sorted. Ions outside of the encoding vector are skipped.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <returns>A pointer to the inverted candidate matrix.</returns>
+template <typename T>
+InvertedCandidateMatrix<T>* createInvertedCandidateMatrix(const CandidateMatrices<T>& m) {
+
+    int rows = candidateMatrixRows(m);
+    int cols = m.empty() ? 0 : (int) m[0].m.cols();
+    int nrThreads = poolThreads();
+
+    auto* inverted = new InvertedCandidateMatrix<T>;
+    inverted->columnOffsets.assign(cols + 1, 0);
+    inverted->rowValues.resize(rows);
+    int64_t* offsets = inverted->columnOffsets.data();
+
+    // the columns are split evenly for counting and by the number of their ions for filling
+    std::vector<int> columnBounds(nrThreads + 1);
+    for (int t = 0; t <= nrThreads; ++t) {
+        columnBounds[t] = (int) ((int64_t) cols * t / nrThreads);
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        runParallel(nrThreads, [&](int t) {
+            int firstColumn = columnBounds[t];
+            int lastColumn = columnBounds[t + 1];
+            int firstValueRow = (int) ((int64_t) rows * t / nrThreads);
+            int lastValueRow = (int) ((int64_t) rows * (t + 1) / nrThreads);
+            std::vector<int> buffer;
+
+            int row = 0;
+            for (const auto& block : m) {
+                const int* outerIndex = block.m.outerIndexPtr();
+                for (int blockRow = 0; blockRow < (int) block.m.rows(); ++blockRow, ++row) {
+                    int rowLength = outerIndex[blockRow + 1] - outerIndex[blockRow];
+                    if (pass == 0 && row >= firstValueRow && row < lastValueRow) {
+                        inverted->rowValues[row] = rowLength == 0 ? 0 :
+                                                   block.m.valuePtr() == NULL ? candidateValue<T>(rowLength, block.normalize) : block.m.valuePtr()[outerIndex[blockRow]];
+                    }
+                    if (rowLength == 0 || firstColumn == lastColumn) {
+                        continue;
+                    }
+
+                    const int* columns = candidateRowColumns(block, blockRow, buffer);
+                    const int* end = columns + rowLength;
+                    for (const int* c = std::lower_bound(columns, end, firstColumn); c < end && *c < lastColumn; ++c) {
+                        if (pass == 0) {
+                            ++offsets[*c + 1];
+                        } else {
+                            inverted->rows[offsets[*c]++] = row;
+                        }
+                    }
+                }
+            }
+        });
+
+        if (pass == 0) {
+            std::partial_sum(offsets, offsets + cols + 1, offsets);
+            inverted->rows.resize(offsets[cols]);
+            for (int t = 1; t < nrThreads; ++t) {
+                columnBounds[t] = (int) (std::lower_bound(offsets, offsets + cols, offsets[cols] * t / nrThreads) - offsets);
+            }
+        }
+    }
+
+    // filling advanced the offset of every column to the offset of the next column
+    std::copy_backward(offsets, offsets + cols, offsets + cols + 1);
+    offsets[0] = 0;
+
+    return inverted;
+}
+
+/// <summary>
+/// Returns the inverted candidate matrix of a candidate index, it is built on first use and kept until the index changes.
+/// </summary>
+/// <param name="index">The candidate index, its precision has to match T.</param>
+/// <returns>A pointer to the inverted candidate matrix owned by the index.</returns>
+template <typename T>
+const InvertedCandidateMatrix<T>* invertedCandidateMatrix(CandidateIndex* index) {
+    std::lock_guard<std::mutex> lock(index->invertedMutex);
+    if constexpr (std::is_same<T, int>::value) {
+        if (index->invertedI32 == NULL) {
+            index->invertedI32 = createInvertedCandidateMatrix<int>(candidateMatrixView<int>(index));
+        }
+        return index->invertedI32;
+    } else {
+        if (index->invertedF32 == NULL) {
+            index->invertedF32 = createInvertedCandidateMatrix<float>(candidateMatrixView<float>(index));
+        }
+        return index->invertedF32;
+    }
+}
+
+/// <summary>
+/// Frees the inverted candidate matrices and bitmap indices of a candidate index, they are rebuilt on the next search with an inverted
+/// index or bitmap index method.
+/// </summary>
+/// <param name="index">The candidate index.</param>
+void releaseInvertedCandidateMatrices(CandidateIndex* index) {
+    std::lock_guard<std::mutex> lock(index->invertedMutex);
+    if (index->invertedF32 != NULL) {
+        delete index->invertedF32;
+        index->invertedF32 = NULL;
+    }
+    if (index->invertedI32 != NULL) {
+        delete index->invertedI32;
+        index->invertedI32 = NULL;
+    }
+    if (index->bitmapF32 != NULL) {
+        delete index->bitmapF32;
+        index->bitmapF32 = NULL;
+    }
+    if (index->bitmapI32 != NULL) {
+        delete index->bitmapI32;
+        index->bitmapI32 = NULL;
+    }
+}
+
+/// <summary>
+/// Creates the bitmap index of a blocked candidate matrix directly from its rows without building its inverted index first. The rows of
+/// every column are split into containers of rows that share their upper 16 bits, containers with at most ROARING_ARRAY_LIMIT rows are
+/// stored as sorted arrays of the lower 16 bits and larger containers as bitmaps. Like the inverted index, every thread owns a contiguous
+/// range of columns and visits the rows of one container key after the other, first to count the containers, arrays and bitmaps of its
+/// columns and then to count and fill the containers of every key, so only the counts of the current key are kept per column.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <returns>A pointer to the bitmap index.</returns>
+template <typename T>
+BitmapCandidateMatrix<T>* createBitmapCandidateMatrix(const CandidateMatrices<T>& m) {
+
+    int rows = candidateMatrixRows(m);
+    int cols = m.empty() ? 0 : (int) m[0].m.cols();
+    int nrKeys = (int) (((int64_t) rows + 0xFFFF) >> 16);
+    int nrThreads = poolThreads();
+
+    auto* bitmap = new BitmapCandidateMatrix<T>;
+    bitmap->columnOffsets.assign(cols + 1, 0);
+    bitmap->arrayOffsets.assign(cols + 1, 0);
+    bitmap->bitmapOffsets.assign(cols + 1, 0);
+    bitmap->rowValues.resize(rows);
+    int64_t* containerOffsets = bitmap->columnOffsets.data();
+    int64_t* arrayOffsets = bitmap->arrayOffsets.data();
+    int64_t* bitmapOffsets = bitmap->bitmapOffsets.data();
+
+    std::vector<int> blockStarts(1, 0);
+    for (const auto& block : m) {
+        blockStarts.push_back(blockStarts.back() + (int) block.m.rows());
+    }
+
+    // the columns are split evenly for counting and by the number of their containers for filling
+    std::vector<int> columnBounds(nrThreads + 1);
+    for (int t = 0; t <= nrThreads; ++t) {
+        columnBounds[t] = (int) ((int64_t) cols * t / nrThreads);
+    }
+
+    // the number of rows of the current key of every column, every thread only touches the counts of its columns
+    std::vector<int> counts(cols, 0);
+
+    // calls body(row, column) for every ion of the rows of a container key in the columns [firstColumn, lastColumn)
+    auto forEachIon = [&](int key, int firstColumn, int lastColumn, std::vector<int>& buffer, const auto& body) {
+        int firstRow = key << 16;
+        int lastRow = rows - firstRow < 0x10000 ? rows : firstRow + 0x10000;
+        int b = (int) (std::upper_bound(blockStarts.begin(), blockStarts.end(), firstRow) - blockStarts.begin()) - 1;
+        for (int row = firstRow; row < lastRow; ++row) {
+            while (row >= blockStarts[b + 1]) {
+                ++b;
+            }
+            const auto& block = m[b];
+            int blockRow = row - blockStarts[b];
+            const int* outerIndex = block.m.outerIndexPtr();
+            int rowLength = outerIndex[blockRow + 1] - outerIndex[blockRow];
+            if (rowLength == 0) {
+                continue;
+            }
+
+            const int* columns = candidateRowColumns(block, blockRow, buffer);
+            const int* end = columns + rowLength;
+            for (const int* c = std::lower_bound(columns, end, firstColumn); c < end && *c < lastColumn; ++c) {
+                body(row, *c);
+            }
+        }
+    };
+
+    for (int pass = 0; pass < 2; ++pass) {
+        runParallel(nrThreads, [&](int t) {
+            int firstColumn = columnBounds[t];
+            int lastColumn = columnBounds[t + 1];
+            std::vector<int> buffer;
+            std::vector<int> touchedColumns;
+
+            // the next container, array row and bitmap word of every column of the thread while filling
+            std::vector<int64_t> nextContainer(containerOffsets + firstColumn, containerOffsets + lastColumn);
+            std::vector<int64_t> nextArrayRow(arrayOffsets + firstColumn, arrayOffsets + lastColumn);
+            std::vector<int64_t> nextBitmapWord(bitmapOffsets + firstColumn, bitmapOffsets + lastColumn);
+
+            if (pass == 0) {
+                int firstValueRow = (int) ((int64_t) rows * t / nrThreads);
+                int lastValueRow = (int) ((int64_t) rows * (t + 1) / nrThreads);
+                for (size_t b = 0; b < m.size(); ++b) {
+                    const auto& block = m[b];
+                    const int* outerIndex = block.m.outerIndexPtr();
+                    int first = firstValueRow > blockStarts[b] ? firstValueRow : blockStarts[b];
+                    int last = lastValueRow < blockStarts[b + 1] ? lastValueRow : blockStarts[b + 1];
+                    for (int row = first; row < last; ++row) {
+                        int blockRow = row - blockStarts[b];
+                        int rowLength = outerIndex[blockRow + 1] - outerIndex[blockRow];
+                        bitmap->rowValues[row] = rowLength == 0 ? 0 :
+                                                 block.m.valuePtr() == NULL ? candidateValue<T>(rowLength, block.normalize) : block.m.valuePtr()[outerIndex[blockRow]];
+                    }
+                }
+            }
+
+            if (firstColumn == lastColumn) {
+                return;
+            }
+
+            for (int key = 0; key < nrKeys; ++key) {
+                forEachIon(key, firstColumn, lastColumn, buffer, [&](int, int column) {
+                    if (counts[column]++ == 0) {
+                        touchedColumns.push_back(column);
+                    }
+                });
+
+                if (pass == 0) {
+                    for (int column : touchedColumns) {
+                        ++containerOffsets[column + 1];
+                        if (counts[column] <= ROARING_ARRAY_LIMIT) {
+                            arrayOffsets[column + 1] += counts[column];
+                        } else {
+                            bitmapOffsets[column + 1] += ROARING_BITMAP_WORDS;
+                        }
+                        counts[column] = 0;
+                    }
+                    touchedColumns.clear();
+                    continue;
+                }
+
+                for (int column : touchedColumns) {
+                    RoaringContainer& container = bitmap->containers[nextContainer[column - firstColumn]++];
+                    container.key = (uint16_t) key;
+                    container.cardinalityMinusOne = (uint16_t) (counts[column] - 1);
+                }
+
+                forEachIon(key, firstColumn, lastColumn, buffer, [&](int row, int column) {
+                    int low = row & 0xFFFF;
+                    if (counts[column] <= ROARING_ARRAY_LIMIT) {
+                        bitmap->arrayRows[nextArrayRow[column - firstColumn]++] = (uint16_t) low;
+                    } else {
+                        bitmap->bitmapWords[nextBitmapWord[column - firstColumn] + (low >> 6)] |= (uint64_t) 1 << (low & 63);
+                    }
+                });
+
+                for (int column : touchedColumns) {
+                    if (counts[column] > ROARING_ARRAY_LIMIT) {
+                        nextBitmapWord[column - firstColumn] += ROARING_BITMAP_WORDS;
+                    }
+                    counts[column] = 0;
+                }
+                touchedColumns.clear();
+            }
+        });
+
+        if (pass == 0) {
+            std::partial_sum(containerOffsets, containerOffsets + cols + 1, containerOffsets);
+            std::partial_sum(arrayOffsets, arrayOffsets + cols + 1, arrayOffsets);
+            std::partial_sum(bitmapOffsets, bitmapOffsets + cols + 1, bitmapOffsets);
+            bitmap->containers.resize(containerOffsets[cols]);
+            bitmap->arrayRows.resize(arrayOffsets[cols]);
+            bitmap->bitmapWords.resize(bitmapOffsets[cols], 0);
+            for (int t = 1; t < nrThreads; ++t) {
+                columnBounds[t] = (int) (std::lower_bound(containerOffsets, containerOffsets + cols, containerOffsets[cols] * t / nrThreads) - containerOffsets);
+            }
+        }
+    }
+
+    return bitmap;
+}
+
+/// <summary>
+/// Returns the bitmap index of a candidate index, it is built on first use and kept until the index changes.
+/// </summary>
+/// <param name="index">The candidate index, its precision has to match T.</param>
+/// <returns>A pointer to the bitmap index owned by the index.</returns>
+template <typename T>
+const BitmapCandidateMatrix<T>* bitmapCandidateMatrix(CandidateIndex* index) {
+    std::lock_guard<std::mutex> lock(index->invertedMutex);
+    if constexpr (std::is_same<T, int>::value) {
+        if (index->bitmapI32 == NULL) {
+            index->bitmapI32 = createBitmapCandidateMatrix<int>(candidateMatrixView<int>(index));
+        }
+        return index->bitmapI32;
+    } else {
+        if (index->bitmapF32 == NULL) {
+            index->bitmapF32 = createBitmapCandidateMatrix<float>(candidateMatrixView<float>(index));
+        }
+        return index->bitmapF32;
+    }
+}
+
+/// <summary>
+/// Calculates the top n candidates for each spectrum of a chunk of spectra with the given search method of a candidate index.
+/// </summary>
+/// <param name="index">The candidate index, its precision has to match the precision of the method.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="method">Which search method (int) should be used, see SearchMethod.</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once, only used by the matrix methods.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+void searchIndexSpectra(CandidateIndex* index,
+                        int* spectraValues, int* spectraIdx,
+                        int sVLength, int sILength,
+                        int n, float tolerance,
+                        bool gaussianTol,
+                        int method, int batchSize,
+                        int verbose, int* result, void* scores) {
+
+    switch (method) {
+        case I32_DV:
+            searchDenseVector<int>(candidateMatrixView<int>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, (int*) scores);
+            break;
+        case F32_DV:
+            searchDenseVector<float>(candidateMatrixView<float>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, (float*) scores);
+            break;
+        case I32_DM:
+            searchDenseMatrix<int>(candidateMatrixView<int>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, (int*) scores);
+            break;
+        case F32_DM:
+            searchDenseMatrix<float>(candidateMatrixView<float>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, (float*) scores);
+            break;
+        case I32_SV:
+            searchSparseVector<int>(candidateMatrixView<int>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, (int*) scores);
+            break;
+        case F32_SV:
+            searchSparseVector<float>(candidateMatrixView<float>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, (float*) scores);
+            break;
+        case I32_SM:
+            searchSparseMatrix<int>(candidateMatrixView<int>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, (int*) scores);
+            break;
+        case F32_SM:
+            searchSparseMatrix<float>(candidateMatrixView<float>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, batchSize, verbose, result, (float*) scores);
+            break;
+        case I32_IV:
+            searchInvertedVector<int>(candidateMatrixView<int>(index), *invertedCandidateMatrix<int>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, (int*) scores);
+            break;
+        case F32_IV:
+            searchInvertedVector<float>(candidateMatrixView<float>(index), *invertedCandidateMatrix<float>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, gaussianTol, verbose, result, (float*) scores);
+            break;
+        case I32_BM:
+            searchBitmapVector<int>(candidateMatrixView<int>(index), *bitmapCandidateMatrix<int>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, verbose, result, (int*) scores);
+            break;
+        default:
+            searchBitmapVector<float>(candidateMatrixView<float>(index), *bitmapCandidateMatrix<float>(index), index->geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, verbose, result, (float*) scores);
+            break;
+    }
+}
+
+/// <summary>
+/// Writes an array to a binary candidate index file at the current position.
+/// </summary>
+/// <param name="file">The index file.</param>
+/// <param name="data">The array to write.</param>
+/// <param name="length">Length (int64_t) of the array.</param>
+template <typename T>
+void writeIndexArray(std::ofstream& file, const T* data, int64_t length) {
+    file.write((const char*) data, length * sizeof(T));
+}
+
+/// <summary>
+/// Pads a binary candidate index file with zeros up to the next multiple of INDEX_FILE_ALIGNMENT bytes.
+/// </summary>
+/// <param name="file">The index file.</param>
+void padIndexFile(std::ofstream& file) {
+    int64_t position = (int64_t) file.tellp();
+    int64_t padding = alignIndexFileOffset(position) - position;
+    char zeros[INDEX_FILE_ALIGNMENT] = {0};
+    file.write(zeros, padding);
+}
+
+/// <summary>
+/// Calculates the top n candidates for each spectrum by multiplying the candidate matrix with a sparse spectrum vector (SpM*SpV).
+/// Spectra are searched in parallel, each thread multiplies its own spectrum vector.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="geometry">The encoding geometry of the candidate matrix and the spectra.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+template <typename T>
+void searchSparseVector(const CandidateMatrices<T>& m,
+                        const EncodingGeometry& geometry,
+                        int* spectraValues, int* spectraIdx,
+                        int sVLength, int sILength,
+                        int n, float tolerance,
+                        bool gaussianTol,
+                        int verbose, int* result, T* scores) {
+
+    int cILength = candidateMatrixRows(m);
+    ToleranceKernel<T> kernel = createToleranceKernel<T>(tolerance, gaussianTol, geometry);
+    std::atomic<int> nextSpectrum(0);
+    std::atomic<int> nrSearched(0);
+    std::mutex outputMutex;
+
+    // Eigen does not parallelize sparse matrix - sparse vector products, so spectra are searched concurrently instead
+    runParallel(poolThreads(), [&](int) {
+        TopRowSelector<T> selector;
+        std::vector<int> sortedPeaks;
+        std::vector<int> bins;
+        std::vector<T> values;
+
+        for (int i = nextSpectrum++; i < sILength; i = nextSpectrum++) {
+            int startIter = spectraIdx[i];
+            int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
+            bins.clear();
+            values.clear();
+            encodeSparseSpectrum(kernel, spectraValues + startIter, endIter - startIter, sortedPeaks, bins, values);
+
+            // the encoded bins are already sorted, so they are copied into the compressed storage of the sparse vector directly
+            auto* v = new Eigen::SparseVector<T, Eigen::ColMajor>(geometry.encodingSize);
+            v->resizeNonZeros((Eigen::Index) bins.size());
+            std::copy(bins.begin(), bins.end(), v->innerIndexPtr());
+            std::copy(values.begin(), values.end(), v->valuePtr());
+
+            auto* spmv = new Eigen::Vector<T, Eigen::Dynamic>(cILength);
+            multiplyCandidateMatrices(m, *v, *spmv);
+
+            const int* top = selectTopRows(spmv->data(), (const int*) NULL, cILength, n, selector);
+            expandTopCandidates(m, top, selector.scores.data(), (int) selector.rows.size(), n, result + (int64_t) i * n, scores != NULL ? scores + (int64_t) i * n : NULL);
+
+            spmv->resize(0);
+            v->resize(0);
+            delete spmv;
+            delete v;
+            spmv = NULL;
+            v = NULL;
+
+            if (verbose != 0) {
+                int searched = ++nrSearched;
+                if (searched % verbose == 0) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << "Searched " << searched << " spectra in total..." << std::endl;
+                }
+            }
+        }
+    });
+}
+
+/// <summary>
+/// Calculates the top n candidates for each spectrum by multiplying the candidate matrix with a dense spectrum vector (SpM*V). Binary
+/// spectra of i32 or unnormalized f32 candidate matrices without delta encoded column indices are scored with a spectrum bitset instead,
+/// see searchBitsetVector.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="geometry">The encoding geometry of the candidate matrix and the spectra.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+template <typename T>
+void searchDenseVector(const CandidateMatrices<T>& m,
+                       const EncodingGeometry& geometry,
+                       int* spectraValues, int* spectraIdx,
+                       int sVLength, int sILength,
+                       int n, float tolerance,
+                       bool gaussianTol,
+                       int verbose, int* result, T* scores) {
+
+    // summing normalized f32 values ion by ion may round differently than the product of the bitset, so those keep the dense vector
+    bool hasColumnDeltas = std::any_of(m.begin(), m.end(), [](const CandidateBlock<T>& block) { return block.columnDeltas != NULL; });
+    bool normalizedF32 = !std::is_same<T, int>::value && std::any_of(m.begin(), m.end(), [](const CandidateBlock<T>& block) { return block.normalize; });
+    if (!gaussianTol && !hasColumnDeltas && !normalizedF32) {
+        searchBitsetVector(m, geometry, spectraValues, spectraIdx, sVLength, sILength, n, tolerance, verbose, result, scores);
+        return;
+    }
+
+    int cILength = candidateMatrixRows(m);
+    ToleranceKernel<T> kernel = createToleranceKernel<T>(tolerance, gaussianTol, geometry);
+    TopRowSelector<T> selector;
+
+    // the spectrum and result vectors are reused for all spectra, only the bins encoded for the previous spectrum are reset
+    auto* v = new Eigen::Vector<T, Eigen::Dynamic>(geometry.encodingSize);
+    auto* spmv = new Eigen::Vector<T, Eigen::Dynamic>(cILength);
+    v->setZero();
+
+    for (int i = 0; i < sILength; ++i) {
+        int startIter = spectraIdx[i];
+        int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
+        encodeSpectrum(kernel, spectraValues + startIter, endIter - startIter, v->data(), 1);
+
+        multiplyCandidateMatrices(m, *v, *spmv);
+
+        const int* top = selectTopRows(spmv->data(), (const int*) NULL, cILength, n, selector);
+        expandTopCandidates(m, top, selector.scores.data(), (int) selector.rows.size(), n, result + (int64_t) i * n, scores != NULL ? scores + (int64_t) i * n : NULL);
+
+        clearSpectrum(kernel, spectraValues + startIter, endIter - startIter, v->data(), 1);
+
+        if (verbose != 0 && (i + 1) % verbose == 0) {
+            std::cout << "Searched " << i + 1 << " spectra in total..." << std::endl;
+        }
+    }
+
+    spmv->resize(0);
+    v->resize(0);
+    delete spmv;
+    delete v;
+    spmv = NULL;
+    v = NULL;
+}
+
+/// <summary>
+/// Calculates the top n candidates for each spectrum with binary peak matching by testing the column indices of every candidate row
+/// against a spectrum bitset. The bitset needs one bit per bin (62.5 KB for the default encoding size) instead of a dense spectrum vector
+/// of 4 bytes per bin, so it stays in L2 while the rows are streamed. All ions of a row have the same value, so the score of a row is the
+/// number of its ions in covered bins times its value, which equals the product with the dense spectrum vector for i32 values and
+/// unnormalized f32 values. The rows of every block are split among the threads of the current call.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix, their column indices must not be delta encoded.</param>
+/// <param name="geometry">The encoding geometry of the candidate matrix and the spectra.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+template <typename T>
+void searchBitsetVector(const CandidateMatrices<T>& m,
+                        const EncodingGeometry& geometry,
+                        int* spectraValues, int* spectraIdx,
+                        int sVLength, int sILength,
+                        int n, float tolerance,
+                        int verbose, int* result, T* scores) {
+
+    int cILength = candidateMatrixRows(m);
+    ToleranceKernel<T> kernel = createToleranceKernel<T>(tolerance, false, geometry);
+    TopRowSelector<T> selector;
+
+    // the bitset and scores are reused for all spectra, only the words encoded for the previous spectrum are reset
+    std::vector<uint32_t> bits((geometry.encodingSize + 31) / 32, 0);
+    std::vector<T> rowScores(cILength);
+
+    for (int i = 0; i < sILength; ++i) {
+        int startIter = spectraIdx[i];
+        int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
+        encodeSpectrumBits(kernel, spectraValues + startIter, endIter - startIter, bits.data());
+
+        int rowOffset = 0;
+        for (const auto& block : m) {
+            const int* outerIndex = block.m.outerIndexPtr();
+            const int* innerIndex = block.m.innerIndexPtr();
+            const T* values = block.m.valuePtr();
+            T* blockScores = rowScores.data() + rowOffset;
+
+            parallelFor((int) block.m.rows(), [&](int row) {
+                int rowLength = outerIndex[row + 1] - outerIndex[row];
+                if (rowLength == 0) {
+                    blockScores[row] = 0;
+                } else {
+                    T value = values != NULL ? values[outerIndex[row]] : candidateValue<T>(rowLength, block.normalize);
+                    blockScores[row] = (T) bitsetRowMatches(innerIndex + outerIndex[row], rowLength, bits.data()) * value;
+                }
+            });
+            rowOffset += (int) block.m.rows();
+        }
+
+        const int* top = selectTopRows(rowScores.data(), (const int*) NULL, cILength, n, selector);
+        expandTopCandidates(m, top, selector.scores.data(), (int) selector.rows.size(), n, result + (int64_t) i * n, scores != NULL ? scores + (int64_t) i * n : NULL);
+
+        clearSpectrumBits(kernel, spectraValues + startIter, endIter - startIter, bits.data());
+
+        if (verbose != 0 && (i + 1) % verbose == 0) {
+            std::cout << "Searched " << i + 1 << " spectra in total..." << std::endl;
+        }
+    }
+}
+
+/// <summary>
+/// Calculates the top n candidates for each spectrum by multiplying the candidate matrix with a sparse matrix of spectra (SpM*SpM).
+/// Eigen does not parallelize sparse matrix - sparse matrix products, so the candidate matrix is multiplied in tiles of consecutive rows
+/// that are distributed over the threads of the pool. The scores of a tile are fed into the top n rows of every spectrum right away, so
+/// only one batch is searched at a time and the scores of all candidates are never stored at once.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="geometry">The encoding geometry of the candidate matrix and the spectra.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+template <typename T>
+void searchSparseMatrix(const CandidateMatrices<T>& m,
+                        const EncodingGeometry& geometry,
+                        int* spectraValues, int* spectraIdx,
+                        int sVLength, int sILength,
+                        int n, float tolerance,
+                        bool gaussianTol,
+                        int batchSize,
+                        int verbose, int* result, T* scores) {
+
+    ToleranceKernel<T> kernel = createToleranceKernel<T>(tolerance, gaussianTol, geometry);
+    int nrThreads = poolThreads();
+    int tileRows = SCORE_TILE_SIZE / batchSize > 0 ? SCORE_TILE_SIZE / batchSize : 1;
+    std::vector<std::array<int, 3>> tiles = candidateTiles(m, tileRows);
+
+    std::vector<int> sortedPeaks;
+    std::vector<int> columnOffsets;
+    std::vector<int> bins;
+    std::vector<T> values;
+
+    // every thread keeps its own heap of the best rows of every spectrum of the batch, the heaps are merged once the batch is done
+    std::vector<std::vector<std::vector<std::pair<T, int>>>> threadTop(nrThreads, std::vector<std::vector<std::pair<T, int>>>(batchSize));
+    TopRowSelector<T> selector;
+
+    for (int i = 0; i < sILength; i += batchSize) {
+
+        encodeSpectrumBatch(kernel, spectraValues, spectraIdx, sVLength, sILength, i, batchSize, sortedPeaks, columnOffsets, bins, values);
+        Eigen::Map<const Eigen::SparseMatrix<T, Eigen::ColMajor>> columns(geometry.encodingSize, batchSize, (Eigen::Index) bins.size(),
+                                                                            columnOffsets.data(), bins.data(), values.data());
+
+        // the row-major candidate matrix is multiplied with the rows of the spectrum matrix, the conversion to row-major
+        // storage is a single counting sort of the encoded bins
+        auto* M = new Eigen::SparseMatrix<T, Eigen::RowMajor>(columns);
+
+        int nrSpectra = i + batchSize <= sILength ? batchSize : sILength - i;
+        std::atomic<int> nextTile(0);
+        runParallel(nrThreads, [&](int thread) {
+            Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> tileScores;
+
+            for (int tile = nextTile++; tile < (int) tiles.size(); tile = nextTile++) {
+                const auto& block = m[tiles[tile][0]];
+                int first = tiles[tile][1];
+                int last = first + tileRows < (int) block.m.rows() ? first + tileRows : (int) block.m.rows();
+                const int* outerIndex = block.m.outerIndexPtr();
+                CandidateMatrix<T> rowRange(last - first, block.m.cols(), outerIndex[last] - outerIndex[first], outerIndex + first, block.m.innerIndexPtr(), block.m.valuePtr());
+
+                tileScores.resize(last - first, batchSize);
+                tileScores = Eigen::Product(rowRange, *M);
+
+                for (int s = 0; s < nrSpectra; ++s) {
+                    streamTopRows(tileScores.col(s).data(), last - first, tiles[tile][2], n, threadTop[thread][s]);
+                }
+            }
+        });
+
+        for (int s = 0; s < nrSpectra; ++s) {
+            expandThreadTopRows(m, threadTop, s, n, selector, result + (int64_t) (i + s) * n, scores != NULL ? scores + (int64_t) (i + s) * n : NULL);
+        }
+
+        M->resize(0, 0);
+        delete M;
+        M = NULL;
+
+        if (verbose != 0 && (i + batchSize) % verbose == 0) {
+            std::cout << "Searched " << i + batchSize << " spectra in total..." << std::endl;
+        }
+    }
+}
+
+/// <summary>
+/// Splits the ions of a tile of consecutive candidate rows into m/z windows of the given width with a counting sort. The rows of the tile
+/// are visited in ascending order, so the ions of every window stay sorted by row.
+/// </summary>
+/// <param name="block">The block of the candidate matrix the tile belongs to, must have uncompressed column indices and values.</param>
+/// <param name="first">The first row (int) of the tile within the block.</param>
+/// <param name="last">The row (int) behind the last row of the tile within the block.</param>
+/// <param name="windowBins">Number of bins (int) of every m/z window.</param>
+/// <param name="tile">The reusable buffers the split tile is written to.</param>
+template <typename T>
+void splitCandidateTile(const CandidateBlock<T>& block, int first, int last, int windowBins, WindowedCandidateTile<T>& tile) {
+    const int* outerIndex = block.m.outerIndexPtr();
+    const int* innerIndex = block.m.innerIndexPtr();
+    const T* values = block.m.valuePtr();
+    int nrWindows = ((int) block.m.cols() + windowBins - 1) / windowBins;
+    int nnz = outerIndex[last] - outerIndex[first];
+
+    tile.windowOffsets.assign(nrWindows + 1, 0);
+    for (int k = outerIndex[first]; k < outerIndex[last]; ++k) {
+        ++tile.windowOffsets[innerIndex[k] / windowBins + 1];
+    }
+    for (int w = 0; w < nrWindows; ++w) {
+        tile.windowOffsets[w + 1] += tile.windowOffsets[w];
+    }
+
+    tile.rows.resize(nnz);
+    tile.columns.resize(nnz);
+    tile.values.resize(nnz);
+    for (int r = first; r < last; ++r) {
+        for (int k = outerIndex[r]; k < outerIndex[r + 1]; ++k) {
+            int position = tile.windowOffsets[innerIndex[k] / windowBins]++;
+            tile.rows[position] = r - first;
+            tile.columns[position] = innerIndex[k];
+            tile.values[position] = values[k];
+        }
     }
 
-    int usedCores = 0;
-    Eigen::setNbThreads(cores);
-    usedCores = Eigen::nbThreads();
+    // the offsets were shifted by one window while the ions were placed
+    for (int w = nrWindows; w > 0; --w) {
+        tile.windowOffsets[w] = tile.windowOffsets[w - 1];
+    }
+    tile.windowOffsets[0] = 0;
+}
 
-    std::cout << "Running Eigen i32 dense matrix search version " << versionMajor << "." << versionMinor << "." << versionFix << std::endl;
-    std::cout << "Using " << usedCores << " threads in total." << std::endl;
+/// <summary>
+/// Calculates the top n candidates for each spectrum by multiplying the candidate matrix with a dense matrix of spectra (SpM*M).
+/// The candidate matrix is multiplied in tiles of consecutive rows that are distributed over the threads of the pool. The ions of a tile
+/// are scored m/z window by m/z window, so that the rows of the spectrum matrix gathered for a window stay in cache and are reused for
+/// all ions and spectra of the batch. The scores of a tile are fed into the top n rows of every spectrum right away, so the scores of all
+/// candidates are never stored at once.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="geometry">The encoding geometry of the candidate matrix and the spectra.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="batchSize">How many spectra (int) should be searched at once.</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+template <typename T>
+void searchDenseMatrix(const CandidateMatrices<T>& m,
+                       const EncodingGeometry& geometry,
+                       int* spectraValues, int* spectraIdx,
+                       int sVLength, int sILength,
+                       int n, float tolerance,
+                       bool gaussianTol,
+                       int batchSize,
+                       int verbose, int* result, T* scores) {
 
-    auto* m = new Eigen::SparseMatrix<int, Eigen::RowMajor>(cILength, ENCODING_SIZE);
-    m->reserve(Eigen::VectorXi::Constant(cILength, APPROX_NNZ_PER_ROW));
+    ToleranceKernel<T> kernel = createToleranceKernel<T>(tolerance, gaussianTol, geometry);
+    int nrThreads = poolThreads();
+    int tileRows = SCORE_TILE_SIZE / batchSize > 0 ? SCORE_TILE_SIZE / batchSize : 1;
+    int windowBins = QUERY_WINDOW_SIZE / batchSize > 0 ? QUERY_WINDOW_SIZE / batchSize : 1;
 
-    int currentRow = 0;
-    for (int i = 0; i < cILength; ++i) {
-        int startIter = candidatesIdx[i];
-        int endIter = i + 1 == cILength ? cVLength : candidatesIdx[i + 1];
-        int nrNonZero = endIter - startIter;
-        int val = normalize ? (int) round((float) ROUNDING_ACCURACY / (float) nrNonZero) : 1;
-        for (int j = startIter; j < endIter; ++j) {
-            m->insert(currentRow, candidatesValues[j]) = val;
-        }
-        ++currentRow;
-    }
+    std::vector<std::array<int, 3>> tiles = candidateTiles(m, tileRows);
 
-    m->makeCompressed();
+    // the spectrum matrix is reused for all batches, only the bins encoded for the previous batch are reset
+    auto* M = new Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>(geometry.encodingSize, batchSize);
+    M->setZero();
 
-    auto* result = new int[sILength * n];
-    float t = round(tolerance * MASS_MULTIPLIER);
+    // every thread keeps its own heap of the best rows of every spectrum of the batch, the heaps are merged once the batch is done
+    std::vector<std::vector<std::vector<std::pair<T, int>>>> threadTop(nrThreads, std::vector<std::vector<std::pair<T, int>>>(batchSize));
+    TopRowSelector<T> selector;
 
     for (int i = 0; i < sILength; i += batchSize) {
 
-        auto* M = new Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>(ENCODING_SIZE, batchSize);
-        M->setZero();
-
         for (int s = 0; s < batchSize; ++s) {
 
             if (i + s >= sILength) {
@@ -1046,71 +5590,804 @@ int* findTopCandidatesBatched2Int(int* candidatesValues, int* candidatesIdx,
 
             int startIter = spectraIdx[i + s];
             int endIter = i + s + 1 == sILength ? sVLength : spectraIdx[i + s + 1];
-            for (int j = startIter; j < endIter; ++j) {
-                auto currentPeak = spectraValues[j];
-                auto minPeak = currentPeak - t > 0 ? currentPeak - t : 0;
-                auto maxPeak = currentPeak + t < ENCODING_SIZE ? currentPeak + t : ENCODING_SIZE - 1;
-
-                for (int k = minPeak; k <= maxPeak; ++k) {
-                    int currentVal = M->coeff(k, s);
-                    int newVal = gaussianTol ? (int) round(normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) * (float) ROUNDING_ACCURACY) : 1;
-                    M->coeffRef(k, s) = max(currentVal, newVal);
+            encodeSpectrum(kernel, spectraValues + startIter, endIter - startIter, M->data() + s, batchSize);
+        }
+
+        int nrSpectra = i + batchSize <= sILength ? batchSize : sILength - i;
+        std::atomic<int> nextTile(0);
+        runParallel(nrThreads, [&](int thread) {
+            WindowedCandidateTile<T> windowed;
+            Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rowScores;
+            Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> tileScores;
+
+            for (int tile = nextTile++; tile < (int) tiles.size(); tile = nextTile++) {
+                const auto& block = m[tiles[tile][0]];
+                int first = tiles[tile][1];
+                int last = first + tileRows < (int) block.m.rows() ? first + tileRows : (int) block.m.rows();
+                splitCandidateTile(block, first, last, windowBins, windowed);
+
+                rowScores.setZero(last - first, batchSize);
+                for (int k = 0; k < windowed.windowOffsets.back(); ++k) {
+                    rowScores.row(windowed.rows[k]).noalias() += windowed.values[k] * M->row(windowed.columns[k]);
+                }
+
+                // the scores of every spectrum are ranked column by column
+                tileScores = rowScores;
+
+                for (int s = 0; s < nrSpectra; ++s) {
+                    streamTopRows(tileScores.col(s).data(), last - first, tiles[tile][2], n, threadTop[thread][s]);
                 }
             }
+        });
+
+        for (int s = 0; s < nrSpectra; ++s) {
+            expandThreadTopRows(m, threadTop, s, n, selector, result + (int64_t) (i + s) * n, scores != NULL ? scores + (int64_t) (i + s) * n : NULL);
+
+            int startIter = spectraIdx[i + s];
+            int endIter = i + s + 1 == sILength ? sVLength : spectraIdx[i + s + 1];
+            clearSpectrum(kernel, spectraValues + startIter, endIter - startIter, M->data() + s, batchSize);
         }
 
-        auto* spmM = new Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>(cILength, batchSize);
-        *spmM = Eigen::Product(*m, *M);
+        if (verbose != 0 && (i + batchSize) % verbose == 0) {
+            std::cout << "Searched " << i + batchSize << " spectra in total..." << std::endl;
+        }
+    }
 
-        for (int s = 0; s < batchSize; ++s) {
+    M->resize(0, 0);
+    delete M;
+    M = NULL;
+}
 
-            if (i + s >= sILength) {
-                break;
+/// <summary>
+/// Calculates the top n candidates for each spectrum by scoring only the candidates that are listed in the inverted index for the bins
+/// covered by the tolerance windows of the spectrum. Scores are accumulated in a dense array of which only the touched rows are ranked
+/// and reset, spectra are searched in parallel.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="inverted">The inverted index of the candidate matrix.</param>
+/// <param name="geometry">The encoding geometry of the candidate matrix and the spectra.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+template <typename T>
+void searchInvertedVector(const CandidateMatrices<T>& m,
+                          const InvertedCandidateMatrix<T>& inverted,
+                          const EncodingGeometry& geometry,
+                          int* spectraValues, int* spectraIdx,
+                          int sVLength, int sILength,
+                          int n, float tolerance,
+                          bool gaussianTol,
+                          int verbose, int* result, T* scores) {
+
+    int rows = candidateMatrixRows(m);
+    ToleranceKernel<T> kernel = createToleranceKernel<T>(tolerance, gaussianTol, geometry);
+    std::atomic<int> nextSpectrum(0);
+    std::atomic<int> nrSearched(0);
+    std::mutex outputMutex;
+
+    runParallel(poolThreads(), [&](int) {
+        std::vector<T> rowScores(rows, 0);
+        std::vector<int> sortedPeaks;
+        std::vector<int> touchedColumns;
+        std::vector<T> columnValues;
+        std::vector<int> touchedRows;
+        std::vector<int> idx;
+        std::vector<T> idxScores;
+        TopRowSelector<T> selector;
+
+        for (int i = nextSpectrum++; i < sILength; i = nextSpectrum++) {
+            int startIter = spectraIdx[i];
+            int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
+            encodeSparseSpectrum(kernel, spectraValues + startIter, endIter - startIter, sortedPeaks, touchedColumns, columnValues);
+
+            // the bins are visited in ascending order so that neighbouring columns of the inverted index are read consecutively, f32
+            // products are scaled ion by ion and summed in the order of the columns of every row, so that the scores are bit-identical
+            // to the dense vector method
+            for (size_t c = 0; c < touchedColumns.size(); ++c) {
+                int column = touchedColumns[c];
+                T val = columnValues[c];
+                for (int64_t k = inverted.columnOffsets[column]; k < inverted.columnOffsets[column + 1]; ++k) {
+                    int row = inverted.rows[k];
+                    if (rowScores[row] == 0) {
+                        touchedRows.push_back(row);
+                    }
+                    if constexpr (std::is_same<T, int>::value) {
+                        rowScores[row] += val;
+                    } else {
+                        rowScores[row] += inverted.rowValues[row] * val;
+                    }
+                }
             }
 
-            std::vector<int> colValues;
-            colValues.resize(spmM->rows());
-            Eigen::Map<Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>>(colValues.data(), spmM->rows(), 1) = spmM->col(s);
+            // all ions of a row have the same value, so it is applied once to the exact i32 sum of the matched bins
+            if constexpr (std::is_same<T, int>::value) {
+                for (int row : touchedRows) {
+                    rowScores[row] *= inverted.rowValues[row];
+                }
+            }
 
-            auto* idx = new int[cILength];
-            std::iota(idx, idx + cILength, 0);
-            std::sort(idx, idx + cILength, [&](int i, int j) {return colValues[i] > colValues[j];});
+            int nrTouched = (int) touchedRows.size();
+            const int* top = selectTopRows(rowScores.data(), touchedRows.data(), nrTouched, n, selector);
+            idx.assign(top, top + (nrTouched < n ? nrTouched : n));
+
+            // rows without any matched bin score 0 and are only needed if less than n rows were touched
+            if (nrTouched < n) {
+                std::sort(touchedRows.begin(), touchedRows.end());
+                auto touched = touchedRows.begin();
+                for (int row = 0; (int) idx.size() < n && row < rows; ++row) {
+                    if (touched != touchedRows.end() && *touched == row) {
+                        ++touched;
+                    } else {
+                        idx.push_back(row);
+                    }
+                }
+            }
 
-            for (int j = 0; j < n; ++j) {
-                result[(i + s) * n + j] = idx[j];
+            idxScores.clear();
+            for (int row : idx) {
+                idxScores.push_back(rowScores[row]);
             }
+            expandTopCandidates(m, idx.data(), idxScores.data(), (int) idx.size(), n, result + (int64_t) i * n, scores != NULL ? scores + (int64_t) i * n : NULL);
 
-            delete[] idx;
+            for (int row : touchedRows) {
+                rowScores[row] = 0;
+            }
+            touchedRows.clear();
+            touchedColumns.clear();
+            columnValues.clear();
+
+            if (verbose != 0) {
+                int searched = ++nrSearched;
+                if (searched % verbose == 0) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << "Searched " << searched << " spectra in total..." << std::endl;
+                }
+            }
         }
+    });
+}
 
-        spmM->resize(0, 0);
-        delete spmM;
-        spmM = NULL;
-        M->resize(0, 0);
-        delete M;
-        M = NULL;
+/// <summary>
+/// Calculates the top n candidates for each spectrum with binary peak matching by counting the rows of the bitmap index containers of the
+/// bins covered by the tolerance windows of the spectrum. Array containers increment the counts of their rows directly, bitmap containers
+/// are scanned word by word and only the set bits of every word are visited. Counts are accumulated in a dense array of which only the
+/// touched rows are ranked and reset, spectra are searched in parallel.
+/// </summary>
+/// <param name="m">The blocks of the candidate matrix.</param>
+/// <param name="bitmap">The bitmap index of the candidate matrix.</param>
+/// <param name="geometry">The encoding geometry of the candidate matrix and the spectra.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="n">How many of the best hits should be returned (int).</param>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="verbose">Print info every (int) processed spectra.</param>
+/// <param name="result">An integer array of length sILength * n that the indexes of the top n candidates are written to.</param>
+/// <param name="scores">An array of length sILength * n that the scores of the top n candidates are written to, NULL if scores are not
+/// needed.</param>
+template <typename T>
+void searchBitmapVector(const CandidateMatrices<T>& m,
+                        const BitmapCandidateMatrix<T>& bitmap,
+                        const EncodingGeometry& geometry,
+                        int* spectraValues, int* spectraIdx,
+                        int sVLength, int sILength,
+                        int n, float tolerance,
+                        int verbose, int* result, T* scores) {
+
+    int rows = candidateMatrixRows(m);
+    ToleranceKernel<T> kernel = createToleranceKernel<T>(tolerance, false, geometry);
+    std::atomic<int> nextSpectrum(0);
+    std::atomic<int> nrSearched(0);
+    std::mutex outputMutex;
+
+    runParallel(poolThreads(), [&](int) {
+        std::vector<T> rowScores(rows, 0);
+        std::vector<int> sortedPeaks;
+        std::vector<int> touchedColumns;
+        std::vector<T> columnValues;
+        std::vector<int> touchedRows;
+        std::vector<int> idx;
+        std::vector<T> idxScores;
+        TopRowSelector<T> selector;
+
+        // f32 scores add the value of the row for every matched bin instead of multiplying the count, like the dense vector method does
+        auto countRow = [&](int row) {
+            if (rowScores[row] == 0) {
+                touchedRows.push_back(row);
+            }
+            if constexpr (std::is_same<T, int>::value) {
+                rowScores[row] += 1;
+            } else {
+                rowScores[row] += bitmap.rowValues[row];
+            }
+        };
+
+        for (int i = nextSpectrum++; i < sILength; i = nextSpectrum++) {
+            int startIter = spectraIdx[i];
+            int endIter = i + 1 == sILength ? sVLength : spectraIdx[i + 1];
+            encodeSparseSpectrum(kernel, spectraValues + startIter, endIter - startIter, sortedPeaks, touchedColumns, columnValues);
+
+            // every covered bin has the value 1, so the score of a row is the number of its ions in covered bins
+            for (int column : touchedColumns) {
+                const uint16_t* lows = bitmap.arrayRows.data() + bitmap.arrayOffsets[column];
+                const uint64_t* words = bitmap.bitmapWords.data() + bitmap.bitmapOffsets[column];
+                for (int64_t c = bitmap.columnOffsets[column]; c < bitmap.columnOffsets[column + 1]; ++c) {
+                    const RoaringContainer& container = bitmap.containers[c];
+                    int base = container.key << 16;
+                    int cardinality = container.cardinalityMinusOne + 1;
+                    if (cardinality <= ROARING_ARRAY_LIMIT) {
+                        for (int k = 0; k < cardinality; ++k) {
+                            countRow(base + lows[k]);
+                        }
+                        lows += cardinality;
+                    } else {
+                        for (int w = 0; w < ROARING_BITMAP_WORDS; ++w) {
+                            for (uint64_t word = words[w]; word != 0; word &= word - 1) {
+                                countRow(base + (w << 6) + lowestSetBit(word));
+                            }
+                        }
+                        words += ROARING_BITMAP_WORDS;
+                    }
+                }
+            }
 
-        if (verbose != 0 && (i + batchSize) % verbose == 0) {
-            std::cout << "Searched " << i + batchSize << " spectra in total..." << std::endl;
+            // all ions of a row have the same value, so it is applied once to the exact i32 number of matched bins
+            if constexpr (std::is_same<T, int>::value) {
+                for (int row : touchedRows) {
+                    rowScores[row] *= bitmap.rowValues[row];
+                }
+            }
+
+            int nrTouched = (int) touchedRows.size();
+            const int* top = selectTopRows(rowScores.data(), touchedRows.data(), nrTouched, n, selector);
+            idx.assign(top, top + (nrTouched < n ? nrTouched : n));
+
+            // rows without any matched bin score 0 and are only needed if less than n rows were touched
+            if (nrTouched < n) {
+                std::sort(touchedRows.begin(), touchedRows.end());
+                auto touched = touchedRows.begin();
+                for (int row = 0; (int) idx.size() < n && row < rows; ++row) {
+                    if (touched != touchedRows.end() && *touched == row) {
+                        ++touched;
+                    } else {
+                        idx.push_back(row);
+                    }
+                }
+            }
+
+            idxScores.clear();
+            for (int row : idx) {
+                idxScores.push_back(rowScores[row]);
+            }
+            expandTopCandidates(m, idx.data(), idxScores.data(), (int) idx.size(), n, result + (int64_t) i * n, scores != NULL ? scores + (int64_t) i * n : NULL);
+
+            for (int row : touchedRows) {
+                rowScores[row] = 0;
+            }
+            touchedRows.clear();
+            touchedColumns.clear();
+            columnValues.clear();
+
+            if (verbose != 0) {
+                int searched = ++nrSearched;
+                if (searched % verbose == 0) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << "Searched " << searched << " spectra in total..." << std::endl;
+                }
+            }
         }
+    });
+}
+
+/// <summary>
+/// Returns the value of every ion of a candidate in the candidate matrix.
+/// </summary>
+/// <param name="nrNonZero">The number of ions of the candidate.</param>
+/// <param name="normalize">If candidate vectors should be normalized to sum(elements) = 1 (bool).</param>
+/// <returns>1 / nrNonZero (f32) or round(ROUNDING_ACCURACY / nrNonZero) (i32) if normalize is true, otherwise 1.</returns>
+template <typename T>
+T candidateValue(int nrNonZero, bool normalize) {
+    if constexpr (std::is_same<T, int>::value) {
+        return normalize ? (int) round((float) ROUNDING_ACCURACY / (float) nrNonZero) : 1;
+    } else {
+        return normalize ? 1.0 / (float) nrNonZero : 1.0;
     }
+}
 
-    m->resize(0, 0);
-    delete m;
-    m = NULL;
+/// <summary>
+/// Returns the value of bin k in the encoding vector of a spectrum peak.
+/// </summary>
+/// <param name="k">The bin in the encoding vector.</param>
+/// <param name="currentPeak">The encoded m/z of the spectrum peak.</param>
+/// <param name="t">The encoded tolerance for peak matching.</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <returns>The PDF at k (f32) or round(PDF * ROUNDING_ACCURACY) (i32) if gaussianTol is true, otherwise 1.</returns>
+template <typename T>
+T peakValue(int k, int currentPeak, float t, bool gaussianTol) {
+    if constexpr (std::is_same<T, int>::value) {
+        return gaussianTol ? (int) round(normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) * (float) ROUNDING_ACCURACY) : 1;
+    } else {
+        return gaussianTol ? normpdf((float) k, (float) currentPeak, (float) (t / 3.0)) : 1.0;
+    }
+}
 
-    return result;
+/// <summary>
+/// Precomputes the encoding window of a spectrum peak for the given tolerance, so that peakValue does not have to be evaluated for every
+/// bin of every peak.
+/// </summary>
+/// <param name="tolerance">Tolerance for peak matching (float).</param>
+/// <param name="gaussianTol">If spectrum peaks should be modelled as normal distributions or not (bool).</param>
+/// <param name="geometry">The encoding geometry of the spectra.</param>
+/// <returns>The encoding window with 2 * t + 1 bins, where t is the tolerance encoded with the mass multiplier of the geometry.</returns>
+template <typename T>
+ToleranceKernel<T> createToleranceKernel(float tolerance, bool gaussianTol, const EncodingGeometry& geometry) {
+    float t = round(tolerance * geometry.massMultiplier);
+    ToleranceKernel<T> kernel;
+    kernel.width = t > 0 ? (int) t : 0;
+    kernel.encodingSize = geometry.encodingSize;
+    kernel.values.resize(2 * kernel.width + 1);
+    for (int k = -kernel.width; k <= kernel.width; ++k) {
+        kernel.values[kernel.width + k] = peakValue<T>(k, 0, t, gaussianTol);
+    }
+    return kernel;
 }
 
 /// <summary>
-/// Free memory after result has been marshalled.
+/// Encodes the peaks of a spectrum into a spectrum vector by taking the maximum of every bin and the encoding windows of all peaks
+/// covering it. Bins that are not covered by any peak are not changed.
 /// </summary>
-/// <param name="result">The result array.</param>
-/// <returns>0</returns>
-int releaseMemory(int* result) {
+/// <param name="kernel">The encoding window of a spectrum peak.</param>
+/// <param name="peaks">The encoded m/z of the spectrum peaks.</param>
+/// <param name="nrPeaks">Number (int) of peaks.</param>
+/// <param name="v">The spectrum vector, bin k is stored at v[k * stride].</param>
+/// <param name="stride">Distance (int) between consecutive bins of the spectrum vector, e.g. the batch size of a row-major spectrum matrix.</param>
+template <typename T>
+void encodeSpectrum(const ToleranceKernel<T>& kernel, const int* peaks, int nrPeaks, T* v, int stride) {
+    if (stride == 1) {
+        for (int j = 0; j < nrPeaks; ++j) {
+            encodeSpectrumPeak(kernel, peaks[j], v);
+        }
+        return;
+    }
 
-    delete[] result;
-    return 0;
+    for (int j = 0; j < nrPeaks; ++j) {
+        int currentPeak = peaks[j];
+        int minPeak = currentPeak - kernel.width > 0 ? currentPeak - kernel.width : 0;
+        int maxPeak = currentPeak + kernel.width < kernel.encodingSize ? currentPeak + kernel.width : kernel.encodingSize - 1;
+        const T* window = kernel.values.data() + kernel.width + minPeak - currentPeak;
+
+        for (int k = 0; k <= maxPeak - minPeak; ++k) {
+            T* bin = v + (int64_t) (minPeak + k) * stride;
+            *bin = max(*bin, window[k]);
+        }
+    }
+}
+
+/// <summary>
+/// Encodes a single peak into a contiguous spectrum vector. The encoding window is combined with the spectrum vector eight bins at a
+/// time with AVX2 or four bins at a time with SSE2 if available.
+/// </summary>
+/// <param name="kernel">The encoding window of a spectrum peak.</param>
+/// <param name="currentPeak">The encoded m/z of the spectrum peak.</param>
+/// <param name="v">The spectrum vector of length kernel.encodingSize.</param>
+template <typename T>
+void encodeSpectrumPeak(const ToleranceKernel<T>& kernel, int currentPeak, T* v) {
+    int minPeak = currentPeak - kernel.width > 0 ? currentPeak - kernel.width : 0;
+    int maxPeak = currentPeak + kernel.width < kernel.encodingSize ? currentPeak + kernel.width : kernel.encodingSize - 1;
+    int length = maxPeak - minPeak + 1;
+    const T* window = kernel.values.data() + kernel.width + minPeak - currentPeak;
+    T* bins = v + minPeak;
+    int k = 0;
+
+#if defined(USE_SSE2) && defined(__AVX2__)
+    for (; k + 8 <= length; k += 8) {
+        if constexpr (std::is_same<T, int>::value) {
+            __m256i current = _mm256_loadu_si256((const __m256i*) (bins + k));
+            __m256i peak = _mm256_loadu_si256((const __m256i*) (window + k));
+            _mm256_storeu_si256((__m256i*) (bins + k), _mm256_max_epi32(current, peak));
+        } else {
+            _mm256_storeu_ps(bins + k, _mm256_max_ps(_mm256_loadu_ps(bins + k), _mm256_loadu_ps(window + k)));
+        }
+    }
+#elif defined(USE_SSE2)
+    for (; k + 4 <= length; k += 4) {
+        if constexpr (std::is_same<T, int>::value) {
+            // SSE2 has no 32-bit integer max, so the larger values are selected with a comparison mask
+            __m128i current = _mm_loadu_si128((const __m128i*) (bins + k));
+            __m128i peak = _mm_loadu_si128((const __m128i*) (window + k));
+            __m128i larger = _mm_cmpgt_epi32(peak, current);
+            _mm_storeu_si128((__m128i*) (bins + k), _mm_or_si128(_mm_and_si128(larger, peak), _mm_andnot_si128(larger, current)));
+        } else {
+            _mm_storeu_ps(bins + k, _mm_max_ps(_mm_loadu_ps(bins + k), _mm_loadu_ps(window + k)));
+        }
+    }
+#endif
+
+    for (; k < length; ++k) {
+        bins[k] = max(bins[k], window[k]);
+    }
+}
+
+/// <summary>
+/// Resets the bins of a spectrum vector that were encoded with encodeSpectrum, so that the spectrum vector can be reused for the next
+/// spectrum without clearing all bins.
+/// </summary>
+/// <param name="kernel">The encoding window of a spectrum peak.</param>
+/// <param name="peaks">The encoded m/z of the spectrum peaks.</param>
+/// <param name="nrPeaks">Number (int) of peaks.</param>
+/// <param name="v">The spectrum vector, bin k is stored at v[k * stride].</param>
+/// <param name="stride">Distance (int) between consecutive bins of the spectrum vector, e.g. the batch size of a row-major spectrum matrix.</param>
+template <typename T>
+void clearSpectrum(const ToleranceKernel<T>& kernel, const int* peaks, int nrPeaks, T* v, int stride) {
+    for (int j = 0; j < nrPeaks; ++j) {
+        int currentPeak = peaks[j];
+        int minPeak = currentPeak - kernel.width > 0 ? currentPeak - kernel.width : 0;
+        int maxPeak = currentPeak + kernel.width < kernel.encodingSize ? currentPeak + kernel.width : kernel.encodingSize - 1;
+
+        if (stride == 1) {
+            if (minPeak <= maxPeak) {
+                std::fill(v + minPeak, v + maxPeak + 1, (T) 0);
+            }
+        } else {
+            for (int k = minPeak; k <= maxPeak; ++k) {
+                v[(int64_t) k * stride] = 0;
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Sets the bits of all bins covered by the encoding windows of the peaks of a spectrum in a binary spectrum bitset.
+/// </summary>
+/// <param name="kernel">The encoding window of a spectrum peak, only its width and the encoding size are used.</param>
+/// <param name="peaks">The encoded m/z of the spectrum peaks.</param>
+/// <param name="nrPeaks">Number (int) of peaks.</param>
+/// <param name="bits">The spectrum bitset, bin k is bit k % 32 of bits[k / 32].</param>
+template <typename T>
+void encodeSpectrumBits(const ToleranceKernel<T>& kernel, const int* peaks, int nrPeaks, uint32_t* bits) {
+    for (int j = 0; j < nrPeaks; ++j) {
+        int currentPeak = peaks[j];
+        int minPeak = currentPeak - kernel.width > 0 ? currentPeak - kernel.width : 0;
+        int maxPeak = currentPeak + kernel.width < kernel.encodingSize ? currentPeak + kernel.width : kernel.encodingSize - 1;
+
+        for (int k = minPeak; k <= maxPeak; ++k) {
+            bits[k >> 5] |= (uint32_t) 1 << (k & 31);
+        }
+    }
+}
+
+/// <summary>
+/// Resets the words of a spectrum bitset that were encoded with encodeSpectrumBits, so that the bitset can be reused for the next
+/// spectrum without clearing all words.
+/// </summary>
+/// <param name="kernel">The encoding window of a spectrum peak, only its width and the encoding size are used.</param>
+/// <param name="peaks">The encoded m/z of the spectrum peaks.</param>
+/// <param name="nrPeaks">Number (int) of peaks.</param>
+/// <param name="bits">The spectrum bitset, bin k is bit k % 32 of bits[k / 32].</param>
+template <typename T>
+void clearSpectrumBits(const ToleranceKernel<T>& kernel, const int* peaks, int nrPeaks, uint32_t* bits) {
+    for (int j = 0; j < nrPeaks; ++j) {
+        int currentPeak = peaks[j];
+        int minPeak = currentPeak - kernel.width > 0 ? currentPeak - kernel.width : 0;
+        int maxPeak = currentPeak + kernel.width < kernel.encodingSize ? currentPeak + kernel.width : kernel.encodingSize - 1;
+
+        if (minPeak <= maxPeak) {
+            std::fill(bits + (minPeak >> 5), bits + (maxPeak >> 5) + 1, 0);
+        }
+    }
+}
+
+/// <summary>
+/// Encodes the peaks of a spectrum into the sorted bins and values of a sparse spectrum vector, which are appended to the given vectors
+/// so that several spectra can be encoded into compressed column storage one after another. The peaks are sorted so that the
+/// encoding windows can be merged in a single sweep: a window either starts a new run of bins or overlaps the end of the current run,
+/// so every bin is only visited once per covering peak and no dense vector or sorted insertion is needed. Bins with value 0 are dropped.
+/// </summary>
+/// <param name="kernel">The encoding window of a spectrum peak.</param>
+/// <param name="peaks">The encoded m/z of the spectrum peaks.</param>
+/// <param name="nrPeaks">Number (int) of peaks.</param>
+/// <param name="sortedPeaks">Scratch vector for the sorted peaks.</param>
+/// <param name="bins">The vector the encoded bins are appended to in ascending order.</param>
+/// <param name="values">The vector the values of the encoded bins are appended to.</param>
+template <typename T>
+void encodeSparseSpectrum(const ToleranceKernel<T>& kernel, const int* peaks, int nrPeaks,
+                          std::vector<int>& sortedPeaks, std::vector<int>& bins, std::vector<T>& values) {
+    size_t first = bins.size();
+    if (!std::is_sorted(peaks, peaks + nrPeaks)) {
+        sortedPeaks.assign(peaks, peaks + nrPeaks);
+        std::sort(sortedPeaks.begin(), sortedPeaks.end());
+        peaks = sortedPeaks.data();
+    }
+
+    for (int j = 0; j < nrPeaks; ++j) {
+        int currentPeak = peaks[j];
+        int minPeak = currentPeak - kernel.width > 0 ? currentPeak - kernel.width : 0;
+        int maxPeak = currentPeak + kernel.width < kernel.encodingSize ? currentPeak + kernel.width : kernel.encodingSize - 1;
+        const T* window = kernel.values.data() + kernel.width + minPeak - currentPeak;
+        int k = minPeak;
+
+        // the window overlaps the current run, since all windows have the same width it starts within the run
+        if (bins.size() > first && minPeak <= bins.back()) {
+            T* run = values.data() + values.size() - 1 - (bins.back() - minPeak);
+            for (; k <= bins.back() && k <= maxPeak; ++k) {
+                run[k - minPeak] = max(run[k - minPeak], window[k - minPeak]);
+            }
+        }
+        for (; k <= maxPeak; ++k) {
+            bins.push_back(k);
+            values.push_back(window[k - minPeak]);
+        }
+    }
+
+    size_t nnz = first;
+    for (size_t k = first; k < bins.size(); ++k) {
+        if (values[k] != 0) {
+            bins[nnz] = bins[k];
+            values[nnz] = values[k];
+            ++nnz;
+        }
+    }
+    bins.resize(nnz);
+    values.resize(nnz);
+}
+
+/// <summary>
+/// Encodes a batch of spectra into the compressed column storage of a sparse spectrum matrix with kernel.encodingSize rows and one column per
+/// spectrum. Every spectrum is encoded with encodeSparseSpectrum straight into the column arrays, so no dense spectrum vector is scanned.
+/// Columns of spectra beyond the last spectrum are empty.
+/// </summary>
+/// <param name="kernel">The encoding window of a spectrum peak.</param>
+/// <param name="spectraValues">An integer array of peaks from experimental spectra flattened.</param>
+/// <param name="spectraIdx">An integer array that contains indices of where each spectrum starts in spectraValues.</param>
+/// <param name="sVLength">Length (int) of spectraValues.</param>
+/// <param name="sILength">Length (int) of spectraIdx.</param>
+/// <param name="firstSpectrum">Index (int) of the first spectrum of the batch.</param>
+/// <param name="batchSize">How many spectra (int) the batch consists of.</param>
+/// <param name="sortedPeaks">Scratch vector for the sorted peaks.</param>
+/// <param name="columnOffsets">The vector the column offsets (batchSize + 1) are written to.</param>
+/// <param name="bins">The vector the encoded bins of all columns are written to.</param>
+/// <param name="values">The vector the values of the encoded bins of all columns are written to.</param>
+template <typename T>
+void encodeSpectrumBatch(const ToleranceKernel<T>& kernel,
+                         const int* spectraValues, const int* spectraIdx,
+                         int sVLength, int sILength,
+                         int firstSpectrum, int batchSize,
+                         std::vector<int>& sortedPeaks, std::vector<int>& columnOffsets,
+                         std::vector<int>& bins, std::vector<T>& values) {
+    columnOffsets.assign(1, 0);
+    bins.clear();
+    values.clear();
+
+    for (int s = firstSpectrum; s < firstSpectrum + batchSize; ++s) {
+        if (s < sILength) {
+            int startIter = spectraIdx[s];
+            int endIter = s + 1 == sILength ? sVLength : spectraIdx[s + 1];
+            encodeSparseSpectrum(kernel, spectraValues + startIter, endIter - startIter, sortedPeaks, bins, values);
+        }
+        columnOffsets.push_back((int) bins.size());
+    }
+}
+
+/// <summary>
+/// Returns the largest ion of the flattened candidate arrays, which determines the encoding size needed for the candidates.
+/// </summary>
+/// <param name="candidatesValues">An integer array of theoretical ion masses for all candidates flattened.</param>
+/// <param name="firstIdx">Index (int64) of the first ion of the first candidate in candidatesValues.</param>
+/// <param name="cVLength">Length (int64) of candidatesValues.</param>
+/// <returns>The largest ion (int), -1 if there are no ions.</returns>
+int largestCandidateIon(const int* candidatesValues, int64_t firstIdx, int64_t cVLength) {
+    int largestIon = -1;
+    for (int64_t i = firstIdx; i < cVLength; ++i) {
+        largestIon = candidatesValues[i] > largestIon ? candidatesValues[i] : largestIon;
+    }
+    return largestIon;
+}
+
+/// <summary>
+/// Returns the position of the lowest set bit of a 64-bit word.
+/// </summary>
+/// <param name="word">The word, must not be 0.</param>
+/// <returns>The number of trailing zero bits (int) of the word.</returns>
+int lowestSetBit(uint64_t word) {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward64(&bit, word);
+    return (int) bit;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+/// <summary>
+/// Returns the FNV-1a hash of the ions of a candidate.
+/// </summary>
+/// <param name="ions">The encoded ions of the candidate.</param>
+/// <param name="length">Number (int) of ions.</param>
+/// <returns>The 64-bit hash of the ions.</returns>
+uint64_t hashCandidateRow(const int* ions, int length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ (uint32_t) ions[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/// <summary>
+/// Delta encodes the sorted column indices of a candidate. Every column is stored as the 16-bit difference to the previous column (or
+/// to 0 for the first column), differences that do not fit into 16 bits are stored as COLUMN_DELTA_ESCAPE followed by the low and high
+/// 16 bits of the column.
+/// </summary>
+/// <param name="columns">The sorted column indices of the candidate.</param>
+/// <param name="length">Number (int) of column indices.</param>
+/// <param name="deltas">The array the deltas are written to, if NULL the deltas are only counted.</param>
+/// <returns>The number (int64_t) of 16-bit words needed to encode the column indices.</returns>
+int64_t encodeCandidateColumns(const int* columns, int length, uint16_t* deltas) {
+    int64_t nrDeltas = 0;
+    int previous = 0;
+    for (int i = 0; i < length; ++i) {
+        int delta = columns[i] - previous;
+        if (delta >= 0 && delta < COLUMN_DELTA_ESCAPE) {
+            if (deltas != NULL) {
+                deltas[nrDeltas] = (uint16_t) delta;
+            }
+            nrDeltas += 1;
+        } else {
+            if (deltas != NULL) {
+                deltas[nrDeltas] = COLUMN_DELTA_ESCAPE;
+                deltas[nrDeltas + 1] = (uint16_t) (columns[i] & 0xFFFF);
+                deltas[nrDeltas + 2] = (uint16_t) ((uint32_t) columns[i] >> 16);
+            }
+            nrDeltas += 3;
+        }
+        previous = columns[i];
+    }
+    return nrDeltas;
+}
+
+/// <summary>
+/// Decodes column indices encoded with encodeCandidateColumns.
+/// </summary>
+/// <param name="deltas">Pointer to the first column delta.</param>
+/// <param name="end">Pointer behind the last column delta.</param>
+/// <param name="columns">The array the column indices are written to.</param>
+void decodeCandidateColumns(const uint16_t* deltas, const uint16_t* end, int* columns) {
+    int column = 0;
+    while (deltas < end) {
+        if (*deltas == COLUMN_DELTA_ESCAPE) {
+            column = (int) deltas[1] | ((int) deltas[2] << 16);
+            deltas += 3;
+        } else {
+            column += *deltas;
+            deltas += 1;
+        }
+        *columns++ = column;
+    }
+}
+
+/// <summary>
+/// Rounds an offset in the binary candidate index file up to the next multiple of INDEX_FILE_ALIGNMENT.
+/// </summary>
+/// <param name="offset">The offset in bytes.</param>
+/// <returns>The aligned offset in bytes.</returns>
+int64_t alignIndexFileOffset(int64_t offset) {
+    return (offset + INDEX_FILE_ALIGNMENT - 1) / INDEX_FILE_ALIGNMENT * INDEX_FILE_ALIGNMENT;
+}
+
+/// <summary>
+/// Checks if an array of the binary candidate index file is aligned and lies within the file after the segment table.
+/// </summary>
+/// <param name="offset">The offset of the array in bytes.</param>
+/// <param name="length">The number of elements of the array.</param>
+/// <param name="elementSize">The size of an element in bytes.</param>
+/// <param name="first">The first offset in bytes an array may start at.</param>
+/// <param name="size">The size of the file in bytes.</param>
+/// <returns>True if the array is valid.</returns>
+bool validIndexFileArray(int64_t offset, int64_t length, int64_t elementSize, int64_t first, size_t size) {
+    return offset >= first && offset % INDEX_FILE_ALIGNMENT == 0 && offset <= (int64_t) size &&
+           length >= 0 && length <= ((int64_t) size - offset) / elementSize;
+}
+
+/// <summary>
+/// Checks if an entry of the segment table of a binary candidate index file describes arrays that lie within the file and if the
+/// first and last offsets of the arrays match the numbers of rows, ions and candidates of the entry.
+/// </summary>
+/// <param name="entry">The entry of the segment table.</param>
+/// <param name="data">The mapped file.</param>
+/// <param name="size">The size of the file in bytes.</param>
+/// <param name="first">The first offset in bytes an array may start at, the end of the segment table.</param>
+/// <param name="compressed">If column indices are delta encoded.</param>
+/// <param name="patternOnly">If the index has no values.</param>
+/// <returns>True if the entry is valid.</returns>
+bool validIndexFileSegment(const CandidateIndexFileSegment& entry, const char* data, size_t size, int64_t first, bool compressed, bool patternOnly) {
+    if (entry.rows < 0 || entry.nnz < 0 || entry.candidates < entry.rows ||
+        !validIndexFileArray(entry.outerIndexOffset, (int64_t) entry.rows + 1, sizeof(int32_t), first, size) ||
+        !validIndexFileArray(entry.rowValuesOffset, entry.rows, sizeof(int32_t), first, size)) {
+        return false;
+    }
+
+    const auto* outerIndex = (const int32_t*) (data + entry.outerIndexOffset);
+    if (outerIndex[0] != 0 || outerIndex[entry.rows] != entry.nnz) {
+        return false;
+    }
+
+    if (compressed) {
+        if (!validIndexFileArray(entry.columnDeltaOffsetsOffset, (int64_t) entry.rows + 1, sizeof(int64_t), first, size) ||
+            !validIndexFileArray(entry.columnDeltasOffset, entry.nrColumnDeltas, sizeof(uint16_t), first, size)) {
+            return false;
+        }
+        const auto* columnDeltaOffsets = (const int64_t*) (data + entry.columnDeltaOffsetsOffset);
+        if (columnDeltaOffsets[0] != 0 || columnDeltaOffsets[entry.rows] != entry.nrColumnDeltas) {
+            return false;
+        }
+    } else if (!validIndexFileArray(entry.innerIndexOffset, entry.nnz, sizeof(int32_t), first, size)) {
+        return false;
+    }
+
+    if (!patternOnly && !validIndexFileArray(entry.valuesOffset, entry.nnz, sizeof(int32_t), first, size)) {
+        return false;
+    }
+
+    if (entry.rowCandidateOffsetsOffset == 0 && entry.rowCandidatesOffset == 0) {
+        return entry.candidates == entry.rows;
+    }
+    if (!validIndexFileArray(entry.rowCandidateOffsetsOffset, (int64_t) entry.rows + 1, sizeof(int32_t), first, size) ||
+        !validIndexFileArray(entry.rowCandidatesOffset, entry.candidates, sizeof(int32_t), first, size)) {
+        return false;
+    }
+    const auto* rowCandidateOffsets = (const int32_t*) (data + entry.rowCandidateOffsetsOffset);
+    return rowCandidateOffsets[0] == 0 && rowCandidateOffsets[entry.rows] == entry.candidates;
+}
+
+/// <summary>
+/// Memory maps a file read-only, the mapping is shared so that all processes mapping the same file use the same pages.
+/// </summary>
+/// <param name="path">Path of the file.</param>
+/// <param name="size">Out parameter that is set to the size of the file in bytes.</param>
+/// <returns>A pointer to the mapped file or NULL if the file could not be mapped.</returns>
+void* mapIndexFile(const char* path, size_t* size) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (fileMapping == NULL) {
+        return NULL;
+    }
+
+    void* mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(fileMapping);
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    *size = (size_t) fileSize.QuadPart;
+    return mapping;
+}
+
+/// <summary>
+/// Unmaps a file mapped with mapIndexFile.
+/// </summary>
+/// <param name="mapping">Pointer to the mapped file.</param>
+/// <param name="size">Size of the mapped file in bytes.</param>
+void unmapIndexFile(void* mapping, size_t size) {
+    UnmapViewOfFile(mapping);
 }
 
 /// <summary>
@@ -1,4 +1,5 @@
-﻿using System.Runtime.InteropServices;
+﻿using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
 
 namespace VectorSearchInterface
 {
@@ -19,6 +20,12 @@ namespace VectorSearchInterface
         /// - f32CPU_SV: Sparse matrix - sparse vector multiplication using float operations.
         /// - i32CPU_SM: Sparse matrix - sparse matrix multiplication using integer operations.
         /// - f32CPU_SM: Sparse matrix - sparse matrix multiplication using float operations.
+        /// - i32CPU_IV: Inverted index - sparse vector scoring using integer operations, only scores candidates sharing an ion with the spectrum.
+        /// - f32CPU_IV: Inverted index - sparse vector scoring using float operations, only scores candidates sharing an ion with the spectrum.
+        /// - i32CPU_BM: Bitmap index - binary spectrum scoring using integer operations, counts the ions of every candidate in the tolerance windows
+        ///   of the spectrum. Only supported by searchCPU with a candidate index and useGaussianTol = false.
+        /// - f32CPU_BM: Bitmap index - binary spectrum scoring using float operations, counts the ions of every candidate in the tolerance windows
+        ///   of the spectrum. Only supported by searchCPU with a candidate index and useGaussianTol = false.
         /// </summary>
         public enum CPU_METHODS
         {
@@ -29,7 +36,27 @@ namespace VectorSearchInterface
             i32CPU_SV,
             f32CPU_SV,
             i32CPU_SM,
-            f32CPU_SM
+            f32CPU_SM,
+            i32CPU_IV,
+            f32CPU_IV,
+            i32CPU_BM,
+            f32CPU_BM
+        }
+
+        /// <summary>
+        /// Enum of available storage layouts of a candidate index on the CPU:
+        /// - CSR: Compressed sparse rows with 32-bit column indices, supports every method of CPU_METHODS.
+        /// - COMPRESSED_COLUMNS: Compressed sparse rows with delta encoded 16-bit column indices, needs roughly half the memory for column indices
+        ///   but only supports i32CPU_DV, f32CPU_DV, i32CPU_IV, f32CPU_IV, i32CPU_BM and f32CPU_BM.
+        /// - PATTERN_ONLY: Compressed sparse rows without values, saves 4 bytes per ion but only supports i32CPU_DV, f32CPU_DV, i32CPU_IV, f32CPU_IV, i32CPU_BM and f32CPU_BM.
+        /// Layouts can be combined, e.g. COMPRESSED_COLUMNS | PATTERN_ONLY.
+        /// </summary>
+        [Flags]
+        public enum INDEX_STORAGE
+        {
+            CSR = 0,
+            COMPRESSED_COLUMNS = 1,
+            PATTERN_ONLY = 2
         }
 
         #endregion
@@ -60,6 +87,22 @@ namespace VectorSearchInterface
                                                        bool normalize, bool gaussianTol,
                                                        int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                 int cVL, int cIL, int sVL, int sIL,
+                                                                 int n, float tolerance,
+                                                                 bool normalize, bool gaussianTol,
+                                                                 int cores, int verbose,
+                                                                 IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                         int cVL, int cIL, int sVL, int sIL,
+                                                         int n, float tolerance,
+                                                         bool normalize, bool gaussianTol,
+                                                         int cores, int verbose,
+                                                         ref int result, ref byte scores);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr findTopCandidatesInt(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
                                                           int cVL, int cIL, int sVL, int sIL,
@@ -67,6 +110,22 @@ namespace VectorSearchInterface
                                                           bool normalize, bool gaussianTol,
                                                           int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesIntWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                    int cVL, int cIL, int sVL, int sIL,
+                                                                    int n, float tolerance,
+                                                                    bool normalize, bool gaussianTol,
+                                                                    int cores, int verbose,
+                                                                    IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesIntInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                            int cVL, int cIL, int sVL, int sIL,
+                                                            int n, float tolerance,
+                                                            bool normalize, bool gaussianTol,
+                                                            int cores, int verbose,
+                                                            ref int result, ref byte scores);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr findTopCandidatesBatched(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
                                                               int cVL, int cIL, int sVL, int sIL,
@@ -75,6 +134,24 @@ namespace VectorSearchInterface
                                                               int batchSize,
                                                               int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesBatchedWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                        int cVL, int cIL, int sVL, int sIL,
+                                                                        int n, float tolerance,
+                                                                        bool normalize, bool gaussianTol,
+                                                                        int batchSize,
+                                                                        int cores, int verbose,
+                                                                        IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesBatchedInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                                int cVL, int cIL, int sVL, int sIL,
+                                                                int n, float tolerance,
+                                                                bool normalize, bool gaussianTol,
+                                                                int batchSize,
+                                                                int cores, int verbose,
+                                                                ref int result, ref byte scores);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr findTopCandidatesBatchedInt(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
                                                                  int cVL, int cIL, int sVL, int sIL,
@@ -83,6 +160,24 @@ namespace VectorSearchInterface
                                                                  int batchSize,
                                                                  int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesBatchedIntWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                           int cVL, int cIL, int sVL, int sIL,
+                                                                           int n, float tolerance,
+                                                                           bool normalize, bool gaussianTol,
+                                                                           int batchSize,
+                                                                           int cores, int verbose,
+                                                                           IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesBatchedIntInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                                   int cVL, int cIL, int sVL, int sIL,
+                                                                   int n, float tolerance,
+                                                                   bool normalize, bool gaussianTol,
+                                                                   int batchSize,
+                                                                   int cores, int verbose,
+                                                                   ref int result, ref byte scores);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr findTopCandidates2(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
                                                         int cVL, int cIL, int sVL, int sIL,
@@ -90,6 +185,22 @@ namespace VectorSearchInterface
                                                         bool normalize, bool gaussianTol,
                                                         int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidates2WithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                  int cVL, int cIL, int sVL, int sIL,
+                                                                  int n, float tolerance,
+                                                                  bool normalize, bool gaussianTol,
+                                                                  int cores, int verbose,
+                                                                  IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidates2Into(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                          int cVL, int cIL, int sVL, int sIL,
+                                                          int n, float tolerance,
+                                                          bool normalize, bool gaussianTol,
+                                                          int cores, int verbose,
+                                                          ref int result, ref byte scores);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr findTopCandidates2Int(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
                                                            int cVL, int cIL, int sVL, int sIL,
@@ -97,6 +208,22 @@ namespace VectorSearchInterface
                                                            bool normalize, bool gaussianTol,
                                                            int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidates2IntWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                     int cVL, int cIL, int sVL, int sIL,
+                                                                     int n, float tolerance,
+                                                                     bool normalize, bool gaussianTol,
+                                                                     int cores, int verbose,
+                                                                     IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidates2IntInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                             int cVL, int cIL, int sVL, int sIL,
+                                                             int n, float tolerance,
+                                                             bool normalize, bool gaussianTol,
+                                                             int cores, int verbose,
+                                                             ref int result, ref byte scores);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr findTopCandidatesBatched2(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
                                                                int cVL, int cIL, int sVL, int sIL,
@@ -105,6 +232,24 @@ namespace VectorSearchInterface
                                                                int batchSize,
                                                                int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesBatched2WithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                         int cVL, int cIL, int sVL, int sIL,
+                                                                         int n, float tolerance,
+                                                                         bool normalize, bool gaussianTol,
+                                                                         int batchSize,
+                                                                         int cores, int verbose,
+                                                                         IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesBatched2Into(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                                 int cVL, int cIL, int sVL, int sIL,
+                                                                 int n, float tolerance,
+                                                                 bool normalize, bool gaussianTol,
+                                                                 int batchSize,
+                                                                 int cores, int verbose,
+                                                                 ref int result, ref byte scores);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr findTopCandidatesBatched2Int(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
                                                                   int cVL, int cIL, int sVL, int sIL,
@@ -113,6 +258,160 @@ namespace VectorSearchInterface
                                                                   int batchSize,
                                                                   int cores, int verbose);
 
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesBatched2IntWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                            int cVL, int cIL, int sVL, int sIL,
+                                                                            int n, float tolerance,
+                                                                            bool normalize, bool gaussianTol,
+                                                                            int batchSize,
+                                                                            int cores, int verbose,
+                                                                            IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesBatched2IntInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                                    int cVL, int cIL, int sVL, int sIL,
+                                                                    int n, float tolerance,
+                                                                    bool normalize, bool gaussianTol,
+                                                                    int batchSize,
+                                                                    int cores, int verbose,
+                                                                    ref int result, ref byte scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesInverted(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                               int cVL, int cIL, int sVL, int sIL,
+                                                               int n, float tolerance,
+                                                               bool normalize, bool gaussianTol,
+                                                               int cores, int verbose);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesInvertedWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                         int cVL, int cIL, int sVL, int sIL,
+                                                                         int n, float tolerance,
+                                                                         bool normalize, bool gaussianTol,
+                                                                         int cores, int verbose,
+                                                                         IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesInvertedInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                                 int cVL, int cIL, int sVL, int sIL,
+                                                                 int n, float tolerance,
+                                                                 bool normalize, bool gaussianTol,
+                                                                 int cores, int verbose,
+                                                                 ref int result, ref byte scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesInvertedInt(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                  int cVL, int cIL, int sVL, int sIL,
+                                                                  int n, float tolerance,
+                                                                  bool normalize, bool gaussianTol,
+                                                                  int cores, int verbose);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr findTopCandidatesInvertedIntWithScores(IntPtr cV, IntPtr cI, IntPtr sV, IntPtr sI,
+                                                                            int cVL, int cIL, int sVL, int sIL,
+                                                                            int n, float tolerance,
+                                                                            bool normalize, bool gaussianTol,
+                                                                            int cores, int verbose,
+                                                                            IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void findTopCandidatesInvertedIntInto(ref int cV, ref int cI, ref int sV, ref int sI,
+                                                                    int cVL, int cIL, int sVL, int sIL,
+                                                                    int n, float tolerance,
+                                                                    bool normalize, bool gaussianTol,
+                                                                    int cores, int verbose,
+                                                                    ref int result, ref byte scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr createCandidateIndex(IntPtr cV, IntPtr cI,
+                                                          int cVL, int cIL,
+                                                          bool normalize, bool useInt,
+                                                          int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr createCandidateIndexWithStorage(IntPtr cV, IntPtr cI,
+                                                                     int cVL, int cIL,
+                                                                     bool normalize, bool useInt,
+                                                                     int storage,
+                                                                     int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr createCandidateIndexWithGeometry(IntPtr cV, IntPtr cI,
+                                                                      int cVL, int cIL,
+                                                                      bool normalize, bool useInt,
+                                                                      int storage,
+                                                                      int massRange, int massMultiplier,
+                                                                      int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr createCandidateIndexFromCSR(IntPtr csrRowoffsets, IntPtr csrColIdx,
+                                                                 int rows, int nnz,
+                                                                 bool normalize, bool useInt,
+                                                                 int massRange, int massMultiplier,
+                                                                 int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int appendCandidateIndex(IntPtr index, IntPtr cV, IntPtr cI,
+                                                       int cVL, int cIL,
+                                                       int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr beginCandidateIndex(bool normalize, bool useInt,
+                                                         int storage,
+                                                         int massRange, int massMultiplier);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int appendCandidateIndexChunk(IntPtr builder, ref int cV, ref int cI,
+                                                            int cVL, int cIL,
+                                                            int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr finishCandidateIndex(IntPtr builder, int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int releaseCandidateIndexBuilder(IntPtr builder);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int compactCandidateIndex(IntPtr index, int cores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr searchCandidateIndex(IntPtr index, IntPtr sV, IntPtr sI,
+                                                          int sVL, int sIL,
+                                                          int n, float tolerance,
+                                                          bool gaussianTol,
+                                                          int method, int batchSize,
+                                                          int cores, int verbose);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr searchCandidateIndexWithScores(IntPtr index, IntPtr sV, IntPtr sI,
+                                                                    int sVL, int sIL,
+                                                                    int n, float tolerance,
+                                                                    bool gaussianTol,
+                                                                    int method, int batchSize,
+                                                                    int cores, int verbose,
+                                                                    IntPtr scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void searchCandidateIndexInto(IntPtr index, ref int sV, ref int sI,
+                                                            int sVL, int sIL,
+                                                            int n, float tolerance,
+                                                            bool gaussianTol,
+                                                            int method, int batchSize,
+                                                            int cores, int verbose,
+                                                            ref int result, ref byte scores);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int saveCandidateIndex(IntPtr index, [MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr loadCandidateIndex([MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int releaseCandidateIndex(IntPtr index);
+
+        [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int configureThreadPool(int threads, bool pinThreads);
+
         [DllImport(dllCPU, CallingConvention = CallingConvention.Cdecl)]
         private static extern int releaseMemory(IntPtr result);
 
@@ -171,11 +470,192 @@ namespace VectorSearchInterface
                                       int topN, float tolerance, bool normalize, bool useGaussianTol,
                                       int batchSize, CPU_METHODS method, int cores, int verbose,
                                       out int memStat)
+        {
+            return searchCPUWithScores(ref candidatesValues, ref candidatesIdx, ref spectraValues, ref spectraIdx,
+                                       topN, tolerance, normalize, useGaussianTol,
+                                       batchSize, method, cores, verbose,
+                                       null, out memStat);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using Eigen and returns their scores. Only supports float (f32) methods.
+        /// </summary>
+        /// <param name="candidatesValues">An integer array of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer array that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="spectraValues">An integer array of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer array that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="scores">A float out parameter array with length (number of spectra * topN) containing the score of every returned candidate.</param>
+        /// <param name="memStat">An integer out parameter indicating if memory was successfully freed after execution, 0 = success, 1 = error.</param>
+        /// <returns>An integer array with length (number of spectra * topN) containing the indices of the top n candidates for every spectrum.</returns>
+        public static int[] searchCPU(ref int[] candidatesValues, ref int[] candidatesIdx, ref int[] spectraValues, ref int[] spectraIdx,
+                                      int topN, float tolerance, bool normalize, bool useGaussianTol,
+                                      int batchSize, CPU_METHODS method, int cores, int verbose,
+                                      out float[] scores, out int memStat)
+        {
+            scores = new float[spectraIdx.Length * topN];
+
+            return searchCPUWithScores(ref candidatesValues, ref candidatesIdx, ref spectraValues, ref spectraIdx,
+                                       topN, tolerance, normalize, useGaussianTol,
+                                       batchSize, method, cores, verbose,
+                                       scores, out memStat);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using Eigen and returns their scores. Only supports integer (i32) methods.
+        /// </summary>
+        /// <param name="candidatesValues">An integer array of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer array that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="spectraValues">An integer array of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer array that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="scores">An integer out parameter array with length (number of spectra * topN) containing the score of every returned candidate.</param>
+        /// <param name="memStat">An integer out parameter indicating if memory was successfully freed after execution, 0 = success, 1 = error.</param>
+        /// <returns>An integer array with length (number of spectra * topN) containing the indices of the top n candidates for every spectrum.</returns>
+        public static int[] searchCPU(ref int[] candidatesValues, ref int[] candidatesIdx, ref int[] spectraValues, ref int[] spectraIdx,
+                                      int topN, float tolerance, bool normalize, bool useGaussianTol,
+                                      int batchSize, CPU_METHODS method, int cores, int verbose,
+                                      out int[] scores, out int memStat)
+        {
+            scores = new int[spectraIdx.Length * topN];
+
+            return searchCPUWithScores(ref candidatesValues, ref candidatesIdx, ref spectraValues, ref spectraIdx,
+                                       topN, tolerance, normalize, useGaussianTol,
+                                       batchSize, method, cores, verbose,
+                                       scores, out memStat);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using Eigen and writes them to the given span, the spans are passed to
+        /// the DLL without copying.
+        /// </summary>
+        /// <param name="candidatesValues">An integer span of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer span that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        public static int searchCPU(ReadOnlySpan<int> candidatesValues, ReadOnlySpan<int> candidatesIdx, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                    int topN, float tolerance, bool normalize, bool useGaussianTol,
+                                    int batchSize, CPU_METHODS method, int cores, int verbose,
+                                    Span<int> result)
+        {
+            return searchCPUInto(candidatesValues, candidatesIdx, spectraValues, spectraIdx,
+                                 topN, tolerance, normalize, useGaussianTol,
+                                 batchSize, method, cores, verbose,
+                                 result, Span<byte>.Empty, isIntMethod(method));
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using Eigen and writes them and their scores to the given spans, the
+        /// spans are passed to the DLL without copying. Only supports float (f32) methods.
+        /// </summary>
+        /// <param name="candidatesValues">An integer span of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer span that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <param name="scores">A float span with at least length (number of spectra * topN) that the score of every returned candidate is written to.</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        public static int searchCPU(ReadOnlySpan<int> candidatesValues, ReadOnlySpan<int> candidatesIdx, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                    int topN, float tolerance, bool normalize, bool useGaussianTol,
+                                    int batchSize, CPU_METHODS method, int cores, int verbose,
+                                    Span<int> result, Span<float> scores)
+        {
+            return searchCPUInto(candidatesValues, candidatesIdx, spectraValues, spectraIdx,
+                                 topN, tolerance, normalize, useGaussianTol,
+                                 batchSize, method, cores, verbose,
+                                 result, MemoryMarshal.AsBytes(scores), false);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using Eigen and writes them and their scores to the given spans, the
+        /// spans are passed to the DLL without copying. Only supports integer (i32) methods.
+        /// </summary>
+        /// <param name="candidatesValues">An integer span of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer span that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <param name="scores">An integer span with at least length (number of spectra * topN) that the score of every returned candidate is written to.</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        public static int searchCPU(ReadOnlySpan<int> candidatesValues, ReadOnlySpan<int> candidatesIdx, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                    int topN, float tolerance, bool normalize, bool useGaussianTol,
+                                    int batchSize, CPU_METHODS method, int cores, int verbose,
+                                    Span<int> result, Span<int> scores)
+        {
+            return searchCPUInto(candidatesValues, candidatesIdx, spectraValues, spectraIdx,
+                                 topN, tolerance, normalize, useGaussianTol,
+                                 batchSize, method, cores, verbose,
+                                 result, MemoryMarshal.AsBytes(scores), true);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using Eigen, scores are written to the given array if it is not null.
+        /// </summary>
+        /// <param name="candidatesValues">An integer array of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer array that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="spectraValues">An integer array of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer array that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="scores">A float array for float (f32) methods or an integer array for integer (i32) methods with length (number of spectra * topN) that the score of every returned candidate is written to, or null.</param>
+        /// <param name="memStat">An integer out parameter indicating if memory was successfully freed after execution, 0 = success, 1 = error.</param>
+        /// <returns>An integer array with length (number of spectra * topN) containing the indices of the top n candidates for every spectrum.</returns>
+        private static int[] searchCPUWithScores(ref int[] candidatesValues, ref int[] candidatesIdx, ref int[] spectraValues, ref int[] spectraIdx,
+                                                 int topN, float tolerance, bool normalize, bool useGaussianTol,
+                                                 int batchSize, CPU_METHODS method, int cores, int verbose,
+                                                 Array? scores, out int memStat)
         {
             var cValuesLoc = GCHandle.Alloc(candidatesValues, GCHandleType.Pinned);
             var cIdxLoc = GCHandle.Alloc(candidatesIdx, GCHandleType.Pinned);
             var sValuesLoc = GCHandle.Alloc(spectraValues, GCHandleType.Pinned);
             var sIdxLoc = GCHandle.Alloc(spectraIdx, GCHandleType.Pinned);
+            var scoresLoc = scores != null ? GCHandle.Alloc(scores, GCHandleType.Pinned) : new GCHandle();
 
             int cVLength = candidatesValues.Length;
             int cILength = candidatesIdx.Length;
@@ -192,14 +672,21 @@ namespace VectorSearchInterface
                 IntPtr cIdxPtr = cIdxLoc.AddrOfPinnedObject();
                 IntPtr sValuesPtr = sValuesLoc.AddrOfPinnedObject();
                 IntPtr sIdxPtr = sIdxLoc.AddrOfPinnedObject();
+                IntPtr scoresPtr = scoresLoc.IsAllocated ? scoresLoc.AddrOfPinnedObject() : IntPtr.Zero;
+
+                if (scores != null && scores is int[] != isIntMethod(method))
+                {
+                    throw new ArgumentException("Precision of the scores array does not match the precision of the search method!");
+                }
 
                 switch(method)
                 {
                     case CPU_METHODS.f32CPU_SV:
-                        IntPtr result1 = findTopCandidates(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                           cVLength, cILength, sVLength, sILength,
-                                                           topN, tolerance, normalize, useGaussianTol,
-                                                           cores, verbose);
+                        IntPtr result1 = findTopCandidatesWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                     cVLength, cILength, sVLength, sILength,
+                                                                     topN, tolerance, normalize, useGaussianTol,
+                                                                     cores, verbose,
+                                                                     scoresPtr);
 
                         Marshal.Copy(result1, resultArray, 0, sILength * topN);
 
@@ -207,10 +694,11 @@ namespace VectorSearchInterface
                         break;
 
                     case CPU_METHODS.f32CPU_DV:
-                        IntPtr result2 = findTopCandidates2(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                            cVLength, cILength, sVLength, sILength,
-                                                            topN, tolerance, normalize, useGaussianTol,
-                                                            cores, verbose);
+                        IntPtr result2 = findTopCandidates2WithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                      cVLength, cILength, sVLength, sILength,
+                                                                      topN, tolerance, normalize, useGaussianTol,
+                                                                      cores, verbose,
+                                                                      scoresPtr);
 
                         Marshal.Copy(result2, resultArray, 0, sILength * topN);
 
@@ -218,10 +706,11 @@ namespace VectorSearchInterface
                         break;
 
                     case CPU_METHODS.f32CPU_SM:
-                        IntPtr result3 = findTopCandidatesBatched(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                                  cVLength, cILength, sVLength, sILength,
-                                                                  topN, tolerance, normalize, useGaussianTol, batchSize,
-                                                                  cores, verbose);
+                        IntPtr result3 = findTopCandidatesBatchedWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                            cVLength, cILength, sVLength, sILength,
+                                                                            topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                                            cores, verbose,
+                                                                            scoresPtr);
 
                         Marshal.Copy(result3, resultArray, 0, sILength * topN);
 
@@ -229,10 +718,11 @@ namespace VectorSearchInterface
                         break;
 
                     case CPU_METHODS.f32CPU_DM:
-                        IntPtr result4 = findTopCandidatesBatched2(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                                   cVLength, cILength, sVLength, sILength,
-                                                                   topN, tolerance, normalize, useGaussianTol, batchSize,
-                                                                   cores, verbose);
+                        IntPtr result4 = findTopCandidatesBatched2WithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                             cVLength, cILength, sVLength, sILength,
+                                                                             topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                                             cores, verbose,
+                                                                             scoresPtr);
 
                         Marshal.Copy(result4, resultArray, 0, sILength * topN);
 
@@ -240,10 +730,11 @@ namespace VectorSearchInterface
                         break;
 
                     case CPU_METHODS.i32CPU_DM:
-                        IntPtr result5 = findTopCandidatesBatched2Int(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                                      cVLength, cILength, sVLength, sILength,
-                                                                      topN, tolerance, normalize, useGaussianTol, batchSize,
-                                                                      cores, verbose);
+                        IntPtr result5 = findTopCandidatesBatched2IntWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                                cVLength, cILength, sVLength, sILength,
+                                                                                topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                                                cores, verbose,
+                                                                                scoresPtr);
 
                         Marshal.Copy(result5, resultArray, 0, sILength * topN);
 
@@ -251,10 +742,11 @@ namespace VectorSearchInterface
                         break;
 
                     case CPU_METHODS.i32CPU_DV:
-                        IntPtr result6 = findTopCandidates2Int(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                               cVLength, cILength, sVLength, sILength,
-                                                               topN, tolerance, normalize, useGaussianTol,
-                                                               cores, verbose);
+                        IntPtr result6 = findTopCandidates2IntWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                         cVLength, cILength, sVLength, sILength,
+                                                                         topN, tolerance, normalize, useGaussianTol,
+                                                                         cores, verbose,
+                                                                         scoresPtr);
 
                         Marshal.Copy(result6, resultArray, 0, sILength * topN);
 
@@ -262,21 +754,51 @@ namespace VectorSearchInterface
                         break;
 
                     case CPU_METHODS.i32CPU_SV:
-                        IntPtr result7 = findTopCandidatesInt(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                              cVLength, cILength, sVLength, sILength,
-                                                              topN, tolerance, normalize, useGaussianTol,
-                                                              cores, verbose);
+                        IntPtr result7 = findTopCandidatesIntWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                        cVLength, cILength, sVLength, sILength,
+                                                                        topN, tolerance, normalize, useGaussianTol,
+                                                                        cores, verbose,
+                                                                        scoresPtr);
 
                         Marshal.Copy(result7, resultArray, 0, sILength * topN);
 
                         memStat = releaseMemory(result7);
                         break;
 
+                    case CPU_METHODS.f32CPU_IV:
+                        IntPtr result8 = findTopCandidatesInvertedWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                             cVLength, cILength, sVLength, sILength,
+                                                                             topN, tolerance, normalize, useGaussianTol,
+                                                                             cores, verbose,
+                                                                             scoresPtr);
+
+                        Marshal.Copy(result8, resultArray, 0, sILength * topN);
+
+                        memStat = releaseMemory(result8);
+                        break;
+
+                    case CPU_METHODS.i32CPU_IV:
+                        IntPtr result9 = findTopCandidatesInvertedIntWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                                cVLength, cILength, sVLength, sILength,
+                                                                                topN, tolerance, normalize, useGaussianTol,
+                                                                                cores, verbose,
+                                                                                scoresPtr);
+
+                        Marshal.Copy(result9, resultArray, 0, sILength * topN);
+
+                        memStat = releaseMemory(result9);
+                        break;
+
+                    case CPU_METHODS.i32CPU_BM:
+                    case CPU_METHODS.f32CPU_BM:
+                        throw new ArgumentException("Bitmap index methods can only be used with a candidate index!");
+
                     default:
-                        IntPtr result = findTopCandidatesBatchedInt(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
-                                                                    cVLength, cILength, sVLength, sILength,
-                                                                    topN, tolerance, normalize, useGaussianTol, batchSize,
-                                                                    cores, verbose);
+                        IntPtr result = findTopCandidatesBatchedIntWithScores(cValuesPtr, cIdxPtr, sValuesPtr, sIdxPtr,
+                                                                              cVLength, cILength, sVLength, sILength,
+                                                                              topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                                              cores, verbose,
+                                                                              scoresPtr);
 
                         Marshal.Copy(result, resultArray, 0, sILength * topN);
 
@@ -296,11 +818,915 @@ namespace VectorSearchInterface
                 if (cIdxLoc.IsAllocated) { cIdxLoc.Free(); }
                 if (sValuesLoc.IsAllocated) { sValuesLoc.Free(); }
                 if (sIdxLoc.IsAllocated) { sIdxLoc.Free(); }
+                if (scoresLoc.IsAllocated) { scoresLoc.Free(); }
             }
 
             return resultArray;
         }
 
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using Eigen and writes them to the given span, scores are written to the
+        /// given span if it is not empty. The spans are pinned for the duration of the call and passed to the DLL without copying.
+        /// </summary>
+        /// <param name="candidatesValues">An integer span of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer span that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <param name="scores">The bytes of a float span for float (f32) methods or an integer span for integer (i32) methods with at least length (number of spectra * topN) that the score of every returned candidate is written to, or an empty span.</param>
+        /// <param name="intScores">Whether the scores span is an integer (i32) or float (f32) span (bool).</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        private static int searchCPUInto(ReadOnlySpan<int> candidatesValues, ReadOnlySpan<int> candidatesIdx, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                         int topN, float tolerance, bool normalize, bool useGaussianTol,
+                                         int batchSize, CPU_METHODS method, int cores, int verbose,
+                                         Span<int> result, Span<byte> scores, bool intScores)
+        {
+            int cVLength = candidatesValues.Length;
+            int cILength = candidatesIdx.Length;
+            int sVLength = spectraValues.Length;
+            int sILength = spectraIdx.Length;
+
+            var status = 1;
+
+            try
+            {
+                if (result.Length < sILength * topN || (!scores.IsEmpty && scores.Length < sILength * topN * sizeof(int)))
+                {
+                    throw new ArgumentException("Result and scores spans must contain at least (number of spectra * topN) elements!");
+                }
+
+                if (!scores.IsEmpty && intScores != isIntMethod(method))
+                {
+                    throw new ArgumentException("Precision of the scores array does not match the precision of the search method!");
+                }
+
+                ref int cValuesRef = ref MemoryMarshal.GetReference(candidatesValues);
+                ref int cIdxRef = ref MemoryMarshal.GetReference(candidatesIdx);
+                ref int sValuesRef = ref MemoryMarshal.GetReference(spectraValues);
+                ref int sIdxRef = ref MemoryMarshal.GetReference(spectraIdx);
+                ref int resultRef = ref MemoryMarshal.GetReference(result);
+                ref byte scoresRef = ref (scores.IsEmpty ? ref Unsafe.NullRef<byte>() : ref MemoryMarshal.GetReference(scores));
+
+                switch(method)
+                {
+                    case CPU_METHODS.f32CPU_SV:
+                        findTopCandidatesInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                              cVLength, cILength, sVLength, sILength,
+                                              topN, tolerance, normalize, useGaussianTol,
+                                              cores, verbose,
+                                              ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.f32CPU_DV:
+                        findTopCandidates2Into(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                               cVLength, cILength, sVLength, sILength,
+                                               topN, tolerance, normalize, useGaussianTol,
+                                               cores, verbose,
+                                               ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.f32CPU_SM:
+                        findTopCandidatesBatchedInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                     cVLength, cILength, sVLength, sILength,
+                                                     topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                     cores, verbose,
+                                                     ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.f32CPU_DM:
+                        findTopCandidatesBatched2Into(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                      cVLength, cILength, sVLength, sILength,
+                                                      topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                      cores, verbose,
+                                                      ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.i32CPU_DM:
+                        findTopCandidatesBatched2IntInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                         cVLength, cILength, sVLength, sILength,
+                                                         topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                         cores, verbose,
+                                                         ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.i32CPU_DV:
+                        findTopCandidates2IntInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                  cVLength, cILength, sVLength, sILength,
+                                                  topN, tolerance, normalize, useGaussianTol,
+                                                  cores, verbose,
+                                                  ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.i32CPU_SV:
+                        findTopCandidatesIntInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                 cVLength, cILength, sVLength, sILength,
+                                                 topN, tolerance, normalize, useGaussianTol,
+                                                 cores, verbose,
+                                                 ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.f32CPU_IV:
+                        findTopCandidatesInvertedInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                      cVLength, cILength, sVLength, sILength,
+                                                      topN, tolerance, normalize, useGaussianTol,
+                                                      cores, verbose,
+                                                      ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.i32CPU_IV:
+                        findTopCandidatesInvertedIntInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                         cVLength, cILength, sVLength, sILength,
+                                                         topN, tolerance, normalize, useGaussianTol,
+                                                         cores, verbose,
+                                                         ref resultRef, ref scoresRef);
+                        break;
+
+                    case CPU_METHODS.i32CPU_BM:
+                    case CPU_METHODS.f32CPU_BM:
+                        throw new ArgumentException("Bitmap index methods can only be used with a candidate index!");
+
+                    default:
+                        findTopCandidatesBatchedIntInto(ref cValuesRef, ref cIdxRef, ref sValuesRef, ref sIdxRef,
+                                                        cVLength, cILength, sVLength, sILength,
+                                                        topN, tolerance, normalize, useGaussianTol, batchSize,
+                                                        cores, verbose,
+                                                        ref resultRef, ref scoresRef);
+                        break;
+                }
+
+                status = 0;
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                status = 1;
+            }
+
+            return status;
+        }
+
+        /// <summary>
+        /// Checks if a CPU method uses integer (i32) or float (f32) operations.
+        /// </summary>
+        /// <param name="method">The CPU method. See enum CPU_METHODS.</param>
+        /// <returns>True if the method uses integer (i32) operations, false otherwise.</returns>
+        private static bool isIntMethod(CPU_METHODS method)
+        {
+            return method == CPU_METHODS.i32CPU_DV || method == CPU_METHODS.i32CPU_DM || method == CPU_METHODS.i32CPU_SV ||
+                   method == CPU_METHODS.i32CPU_SM || method == CPU_METHODS.i32CPU_IV || method == CPU_METHODS.i32CPU_BM;
+        }
+
+        #endregion
+
+        #region CPU_index
+
+        /// <summary>
+        /// Creates a persistent candidate index on the CPU that can be searched multiple times, so the candidate matrix only has to be built once.
+        /// Candidates with identical encoded ions are stored and scored only once, search results still contain every candidate.
+        /// </summary>
+        /// <param name="candidatesValues">An integer array of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer array that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useInt">Whether the index should be searched with integer (i32) or float (f32) methods (bool).</param>
+        /// <param name="cores">The number of CPU cores that should be used for building the index (int).</param>
+        /// <returns>A pointer to the candidate index or IntPtr.Zero if the index could not be created. The index has to be released with releaseIndex().</returns>
+        public static IntPtr createIndex(ref int[] candidatesValues, ref int[] candidatesIdx,
+                                         bool normalize, bool useInt, int cores)
+        {
+            return createIndex(ref candidatesValues, ref candidatesIdx, normalize, useInt, INDEX_STORAGE.CSR, cores);
+        }
+
+        /// <summary>
+        /// Creates a persistent candidate index on the CPU with the given storage layout that can be searched multiple times.
+        /// Candidates with identical encoded ions are stored and scored only once, search results still contain every candidate.
+        /// </summary>
+        /// <param name="candidatesValues">An integer array of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer array that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useInt">Whether the index should be searched with integer (i32) or float (f32) methods (bool).</param>
+        /// <param name="storage">The storage layout of the candidate matrix. See enum INDEX_STORAGE.</param>
+        /// <param name="cores">The number of CPU cores that should be used for building the index (int).</param>
+        /// <returns>A pointer to the candidate index or IntPtr.Zero if the index could not be created. The index has to be released with releaseIndex().</returns>
+        public static IntPtr createIndex(ref int[] candidatesValues, ref int[] candidatesIdx,
+                                         bool normalize, bool useInt, INDEX_STORAGE storage, int cores)
+        {
+            return createIndex(ref candidatesValues, ref candidatesIdx, normalize, useInt, storage, 5000, 100, cores);
+        }
+
+        /// <summary>
+        /// Creates a persistent candidate index on the CPU with the given storage layout and encoding geometry that can be searched multiple times.
+        /// Ions and peaks have to be encoded with massMultiplier bins per m/z, e.g. (int) Math.Round(mz * 1000) for a precision of 0.001.
+        /// If massRange is 0 the encoding only covers the largest ion of the candidates, which saves memory and time for low mass candidates.
+        /// </summary>
+        /// <param name="candidatesValues">An integer array of theoretical ion m/z values for all candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer array that contains indices indicating where each candidate starts in candidatesValues.</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useInt">Whether the index should be searched with integer (i32) or float (f32) methods (bool).</param>
+        /// <param name="storage">The storage layout of the candidate matrix. See enum INDEX_STORAGE.</param>
+        /// <param name="massRange">The largest m/z that is encoded (int), 0 derives it from the largest ion of the candidates. The default is 5000.</param>
+        /// <param name="massMultiplier">The number of bins per m/z that ions and peaks are encoded with (int). The default is 100.</param>
+        /// <param name="cores">The number of CPU cores that should be used for building the index (int).</param>
+        /// <returns>A pointer to the candidate index or IntPtr.Zero if the index could not be created. The index has to be released with releaseIndex().</returns>
+        public static IntPtr createIndex(ref int[] candidatesValues, ref int[] candidatesIdx,
+                                         bool normalize, bool useInt, INDEX_STORAGE storage,
+                                         int massRange, int massMultiplier, int cores)
+        {
+            var cValuesLoc = GCHandle.Alloc(candidatesValues, GCHandleType.Pinned);
+            var cIdxLoc = GCHandle.Alloc(candidatesIdx, GCHandleType.Pinned);
+
+            int cVLength = candidatesValues.Length;
+            int cILength = candidatesIdx.Length;
+
+            var index = IntPtr.Zero;
+
+            try
+            {
+                IntPtr cValuesPtr = cValuesLoc.AddrOfPinnedObject();
+                IntPtr cIdxPtr = cIdxLoc.AddrOfPinnedObject();
+
+                index = createCandidateIndexWithGeometry(cValuesPtr, cIdxPtr,
+                                                         cVLength, cILength,
+                                                         normalize, useInt,
+                                                         (int) storage,
+                                                         massRange, massMultiplier,
+                                                         cores);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                index = IntPtr.Zero;
+            }
+            finally
+            {
+                if (cValuesLoc.IsAllocated) { cValuesLoc.Free(); }
+                if (cIdxLoc.IsAllocated) { cIdxLoc.Free(); }
+            }
+
+            return index;
+        }
+
+        /// <summary>
+        /// Appends candidates to a candidate index created with createIndex() or loadIndex(). Only the appended candidates are encoded,
+        /// they get the indices following the existing candidates of the index.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="candidatesValues">An integer array of theoretical ion m/z values for all appended candidates flattened.</param>
+        /// <param name="candidatesIdx">An integer array that contains indices indicating where each appended candidate starts in candidatesValues.</param>
+        /// <param name="cores">The number of CPU cores that should be used for appending the candidates (int).</param>
+        /// <returns>The index of the first appended candidate or -1 if the candidates could not be appended.</returns>
+        public static int appendIndex(IntPtr index, ref int[] candidatesValues, ref int[] candidatesIdx, int cores)
+        {
+            var cValuesLoc = GCHandle.Alloc(candidatesValues, GCHandleType.Pinned);
+            var cIdxLoc = GCHandle.Alloc(candidatesIdx, GCHandleType.Pinned);
+
+            int cVLength = candidatesValues.Length;
+            int cILength = candidatesIdx.Length;
+
+            var firstCandidate = -1;
+
+            try
+            {
+                IntPtr cValuesPtr = cValuesLoc.AddrOfPinnedObject();
+                IntPtr cIdxPtr = cIdxLoc.AddrOfPinnedObject();
+
+                firstCandidate = appendCandidateIndex(index, cValuesPtr, cIdxPtr,
+                                                      cVLength, cILength,
+                                                      cores);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                firstCandidate = -1;
+            }
+            finally
+            {
+                if (cValuesLoc.IsAllocated) { cValuesLoc.Free(); }
+                if (cIdxLoc.IsAllocated) { cIdxLoc.Free(); }
+            }
+
+            return firstCandidate;
+        }
+
+        /// <summary>
+        /// Merges all candidates appended with appendIndex() into a single block, which speeds up subsequent searches. Candidate indices do not change.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="cores">The number of CPU cores that should be used for compacting the index (int).</param>
+        /// <returns>An integer indicating if the index was successfully compacted, 0 = success, 1 = error.</returns>
+        public static int compactIndex(IntPtr index, int cores)
+        {
+            var status = 1;
+
+            try
+            {
+                status = compactCandidateIndex(index, cores);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                status = 1;
+            }
+
+            return status;
+        }
+
+        /// <summary>
+        /// The pinned CSR arrays of every candidate index created with createIndexFromCSR(), they are unpinned when the index is released.
+        /// </summary>
+        private static readonly Dictionary<IntPtr, GCHandle[]> adoptedArrays = new Dictionary<IntPtr, GCHandle[]>();
+
+        /// <summary>
+        /// Creates a persistent candidate index on the CPU that adopts a candidate matrix in CSR format without copying it. The arrays stay
+        /// pinned until the index is released with releaseIndex() and must not be modified in the meantime. The index stores no values
+        /// (INDEX_STORAGE.PATTERN_ONLY), so only the i32CPU_DV, f32CPU_DV, i32CPU_IV, f32CPU_IV, i32CPU_BM and f32CPU_BM methods can search it.
+        /// </summary>
+        /// <param name="csrRowoffsets">An integer array of row offsets (number of candidates + 1) into csrColIdx, row i is the candidate with index i.</param>
+        /// <param name="csrColIdx">An integer array of the encoded ions of all candidates, the ions of every candidate have to be sorted.</param>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useInt">Whether the index should be searched with integer (i32) or float (f32) methods (bool).</param>
+        /// <param name="massRange">The largest m/z that is encoded (int), 0 derives it from the largest ion of the candidates.</param>
+        /// <param name="massMultiplier">The number of bins per m/z that ions and peaks are encoded with (int).</param>
+        /// <param name="cores">The number of CPU cores that should be used for checking the arrays (int).</param>
+        /// <returns>A pointer to the candidate index or IntPtr.Zero if the index could not be created. The index has to be released with releaseIndex().</returns>
+        public static IntPtr createIndexFromCSR(int[] csrRowoffsets, int[] csrColIdx,
+                                                bool normalize, bool useInt,
+                                                int massRange, int massMultiplier, int cores)
+        {
+            var csrRowoffsetsLoc = GCHandle.Alloc(csrRowoffsets, GCHandleType.Pinned);
+            var csrIdxLoc = GCHandle.Alloc(csrColIdx, GCHandleType.Pinned);
+
+            var index = IntPtr.Zero;
+
+            try
+            {
+                index = createCandidateIndexFromCSR(csrRowoffsetsLoc.AddrOfPinnedObject(), csrIdxLoc.AddrOfPinnedObject(),
+                                                    csrRowoffsets.Length - 1, csrColIdx.Length,
+                                                    normalize, useInt,
+                                                    massRange, massMultiplier,
+                                                    cores);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                index = IntPtr.Zero;
+            }
+
+            if (index == IntPtr.Zero)
+            {
+                csrRowoffsetsLoc.Free();
+                csrIdxLoc.Free();
+            }
+            else
+            {
+                lock (adoptedArrays)
+                {
+                    adoptedArrays[index] = new GCHandle[] { csrRowoffsetsLoc, csrIdxLoc };
+                }
+            }
+
+            return index;
+        }
+
+        /// <summary>
+        /// Begins building a candidate index on the CPU from chunks of candidates, so that the candidates never have to be held in memory all
+        /// at once. Chunks are appended with appendIndexChunk() and the index is completed with finishIndex().
+        /// </summary>
+        /// <param name="normalize">Whether or not the candidate scores should be normalized by candidate length (bool).</param>
+        /// <param name="useInt">Whether the index should be searched with integer (i32) or float (f32) methods (bool).</param>
+        /// <param name="storage">The storage layout of the index. See enum INDEX_STORAGE.</param>
+        /// <param name="massRange">The largest m/z (int) that should be encoded, has to be known before the first chunk is appended.</param>
+        /// <param name="massMultiplier">The number of bins per m/z (int) that ions and peaks are encoded with, e.g. 100 for a precision of 0.01.</param>
+        /// <returns>A pointer to the index builder or IntPtr.Zero if the builder could not be created. The builder has to be completed with finishIndex() or released with releaseIndexBuilder().</returns>
+        public static IntPtr beginIndex(bool normalize, bool useInt, INDEX_STORAGE storage, int massRange, int massMultiplier)
+        {
+            var builder = IntPtr.Zero;
+
+            try
+            {
+                builder = beginCandidateIndex(normalize, useInt, (int) storage, massRange, massMultiplier);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                builder = IntPtr.Zero;
+            }
+
+            return builder;
+        }
+
+        /// <summary>
+        /// Appends a chunk of candidates to an index builder created with beginIndex(). The chunk is copied, so its memory can be reused
+        /// right away, e.g. to generate the next chunk.
+        /// </summary>
+        /// <param name="builder">A pointer to the index builder created with beginIndex().</param>
+        /// <param name="candidatesValues">An integer span of theoretical ion m/z values for all candidates of the chunk flattened.</param>
+        /// <param name="candidatesIdx">An integer span that contains indices indicating where each candidate of the chunk starts in candidatesValues.</param>
+        /// <param name="cores">The number of CPU cores that should be used for encoding the candidates (int).</param>
+        /// <returns>The index of the first candidate of the chunk or -1 if the chunk could not be appended.</returns>
+        public static int appendIndexChunk(IntPtr builder, ReadOnlySpan<int> candidatesValues, ReadOnlySpan<int> candidatesIdx, int cores)
+        {
+            int cVLength = candidatesValues.Length;
+            int cILength = candidatesIdx.Length;
+
+            var firstCandidate = -1;
+
+            try
+            {
+                ref int cValuesRef = ref MemoryMarshal.GetReference(candidatesValues);
+                ref int cIdxRef = ref MemoryMarshal.GetReference(candidatesIdx);
+
+                firstCandidate = appendCandidateIndexChunk(builder, ref cValuesRef, ref cIdxRef,
+                                                           cVLength, cILength,
+                                                           cores);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                firstCandidate = -1;
+            }
+
+            return firstCandidate;
+        }
+
+        /// <summary>
+        /// Completes an index builder created with beginIndex() and returns the candidate index. The builder is released and must not be used afterwards.
+        /// </summary>
+        /// <param name="builder">A pointer to the index builder created with beginIndex().</param>
+        /// <param name="cores">The number of CPU cores that should be used for encoding the remaining candidates (int).</param>
+        /// <returns>A pointer to the candidate index or IntPtr.Zero if the index could not be completed. The index has to be released with releaseIndex().</returns>
+        public static IntPtr finishIndex(IntPtr builder, int cores)
+        {
+            var index = IntPtr.Zero;
+
+            try
+            {
+                index = finishCandidateIndex(builder, cores);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                index = IntPtr.Zero;
+            }
+
+            return index;
+        }
+
+        /// <summary>
+        /// Releases an index builder created with beginIndex() that was not completed with finishIndex().
+        /// </summary>
+        /// <param name="builder">A pointer to the index builder created with beginIndex().</param>
+        /// <returns>An integer indicating if memory was successfully freed, 0 = success, 1 = error.</returns>
+        public static int releaseIndexBuilder(IntPtr builder)
+        {
+            var memStat = 1;
+
+            try
+            {
+                memStat = releaseCandidateIndexBuilder(builder);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                memStat = 1;
+            }
+
+            return memStat;
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex().
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer array of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer array that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="memStat">An integer out parameter indicating if memory was successfully freed after execution, 0 = success, 1 = error.</param>
+        /// <returns>An integer array with length (number of spectra * topN) containing the indices of the top n candidates for every spectrum.</returns>
+        public static int[] searchCPU(IntPtr index, ref int[] spectraValues, ref int[] spectraIdx,
+                                      int topN, float tolerance, bool useGaussianTol,
+                                      int batchSize, CPU_METHODS method, int cores, int verbose,
+                                      out int memStat)
+        {
+            return searchCPUWithScores(index, ref spectraValues, ref spectraIdx,
+                                       topN, tolerance, useGaussianTol,
+                                       batchSize, method, cores, verbose,
+                                       null, out memStat);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex()
+        /// and returns their scores. Only supports float (f32) methods.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer array of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer array that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="scores">A float out parameter array with length (number of spectra * topN) containing the score of every returned candidate.</param>
+        /// <param name="memStat">An integer out parameter indicating if memory was successfully freed after execution, 0 = success, 1 = error.</param>
+        /// <returns>An integer array with length (number of spectra * topN) containing the indices of the top n candidates for every spectrum.</returns>
+        public static int[] searchCPU(IntPtr index, ref int[] spectraValues, ref int[] spectraIdx,
+                                      int topN, float tolerance, bool useGaussianTol,
+                                      int batchSize, CPU_METHODS method, int cores, int verbose,
+                                      out float[] scores, out int memStat)
+        {
+            scores = new float[spectraIdx.Length * topN];
+
+            return searchCPUWithScores(index, ref spectraValues, ref spectraIdx,
+                                       topN, tolerance, useGaussianTol,
+                                       batchSize, method, cores, verbose,
+                                       scores, out memStat);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex()
+        /// and returns their scores. Only supports integer (i32) methods.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer array of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer array that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="scores">An integer out parameter array with length (number of spectra * topN) containing the score of every returned candidate.</param>
+        /// <param name="memStat">An integer out parameter indicating if memory was successfully freed after execution, 0 = success, 1 = error.</param>
+        /// <returns>An integer array with length (number of spectra * topN) containing the indices of the top n candidates for every spectrum.</returns>
+        public static int[] searchCPU(IntPtr index, ref int[] spectraValues, ref int[] spectraIdx,
+                                      int topN, float tolerance, bool useGaussianTol,
+                                      int batchSize, CPU_METHODS method, int cores, int verbose,
+                                      out int[] scores, out int memStat)
+        {
+            scores = new int[spectraIdx.Length * topN];
+
+            return searchCPUWithScores(index, ref spectraValues, ref spectraIdx,
+                                       topN, tolerance, useGaussianTol,
+                                       batchSize, method, cores, verbose,
+                                       scores, out memStat);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex() and
+        /// writes them to the given span, the spans are passed to the DLL without copying.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        public static int searchCPU(IntPtr index, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                    int topN, float tolerance, bool useGaussianTol,
+                                    int batchSize, CPU_METHODS method, int cores, int verbose,
+                                    Span<int> result)
+        {
+            return searchCPUInto(index, spectraValues, spectraIdx,
+                                 topN, tolerance, useGaussianTol,
+                                 batchSize, method, cores, verbose,
+                                 result, Span<byte>.Empty, isIntMethod(method));
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex() and
+        /// writes them and their scores to the given spans, the spans are passed to the DLL without copying. Only supports float (f32) methods.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <param name="scores">A float span with at least length (number of spectra * topN) that the score of every returned candidate is written to.</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        public static int searchCPU(IntPtr index, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                    int topN, float tolerance, bool useGaussianTol,
+                                    int batchSize, CPU_METHODS method, int cores, int verbose,
+                                    Span<int> result, Span<float> scores)
+        {
+            return searchCPUInto(index, spectraValues, spectraIdx,
+                                 topN, tolerance, useGaussianTol,
+                                 batchSize, method, cores, verbose,
+                                 result, MemoryMarshal.AsBytes(scores), false);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex() and
+        /// writes them and their scores to the given spans, the spans are passed to the DLL without copying. Only supports integer (i32) methods.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <param name="scores">An integer span with at least length (number of spectra * topN) that the score of every returned candidate is written to.</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        public static int searchCPU(IntPtr index, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                    int topN, float tolerance, bool useGaussianTol,
+                                    int batchSize, CPU_METHODS method, int cores, int verbose,
+                                    Span<int> result, Span<int> scores)
+        {
+            return searchCPUInto(index, spectraValues, spectraIdx,
+                                 topN, tolerance, useGaussianTol,
+                                 batchSize, method, cores, verbose,
+                                 result, MemoryMarshal.AsBytes(scores), true);
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex(),
+        /// scores are written to the given array if it is not null.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer array of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer array that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="scores">A float array for float (f32) methods or an integer array for integer (i32) methods with length (number of spectra * topN) that the score of every returned candidate is written to, or null.</param>
+        /// <param name="memStat">An integer out parameter indicating if memory was successfully freed after execution, 0 = success, 1 = error.</param>
+        /// <returns>An integer array with length (number of spectra * topN) containing the indices of the top n candidates for every spectrum.</returns>
+        private static int[] searchCPUWithScores(IntPtr index, ref int[] spectraValues, ref int[] spectraIdx,
+                                                 int topN, float tolerance, bool useGaussianTol,
+                                                 int batchSize, CPU_METHODS method, int cores, int verbose,
+                                                 Array? scores, out int memStat)
+        {
+            var sValuesLoc = GCHandle.Alloc(spectraValues, GCHandleType.Pinned);
+            var sIdxLoc = GCHandle.Alloc(spectraIdx, GCHandleType.Pinned);
+            var scoresLoc = scores != null ? GCHandle.Alloc(scores, GCHandleType.Pinned) : new GCHandle();
+
+            int sVLength = spectraValues.Length;
+            int sILength = spectraIdx.Length;
+
+            var resultArray = new int[sILength * topN];
+
+            memStat = 1;
+
+            try
+            {
+                IntPtr sValuesPtr = sValuesLoc.AddrOfPinnedObject();
+                IntPtr sIdxPtr = sIdxLoc.AddrOfPinnedObject();
+                IntPtr scoresPtr = scoresLoc.IsAllocated ? scoresLoc.AddrOfPinnedObject() : IntPtr.Zero;
+
+                if (scores != null && scores is int[] != isIntMethod(method))
+                {
+                    throw new ArgumentException("Precision of the scores array does not match the precision of the search method!");
+                }
+
+                IntPtr result = searchCandidateIndexWithScores(index, sValuesPtr, sIdxPtr,
+                                                               sVLength, sILength,
+                                                               topN, tolerance, useGaussianTol,
+                                                               (int) method, batchSize,
+                                                               cores, verbose,
+                                                               scoresPtr);
+
+                Marshal.Copy(result, resultArray, 0, sILength * topN);
+
+                memStat = releaseMemory(result);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                memStat = 1;
+            }
+            finally
+            {
+                if (sValuesLoc.IsAllocated) { sValuesLoc.Free(); }
+                if (sIdxLoc.IsAllocated) { sIdxLoc.Free(); }
+                if (scoresLoc.IsAllocated) { scoresLoc.Free(); }
+            }
+
+            return resultArray;
+        }
+
+        /// <summary>
+        /// Calculates the top n candidates for each spectrum on the CPU using a candidate index created with createIndex() or loadIndex() and
+        /// writes them to the given span, scores are written to the given span if it is not empty. The spans are pinned for the duration of
+        /// the call and passed to the DLL without copying.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="spectraValues">An integer span of peak m/z values from experimental spectra flattened.</param>
+        /// <param name="spectraIdx">An integer span that contains indices indicating where each spectrum starts in spectraValues.</param>
+        /// <param name="topN">The number (int) of top candidates that should be returned for each spectrum.</param>
+        /// <param name="tolerance">Tolerance used for matching peaks in Dalton (float).</param>
+        /// <param name="useGaussianTol">Whether or not experimental peaks should be modelled as gaussian normal distributions (bool).</param>
+        /// <param name="batchSize">If a batched approach is used, how big should batches be (integer).</param>
+        /// <param name="method">Which matrix multiplication method should be used. See enum CPU_METHODS. Integer (i32) methods require an index created with useInt = true, float (f32) methods one created with useInt = false.</param>
+        /// <param name="cores">The number of CPU cores that should be used for computation (int).</param>
+        /// <param name="verbose">An integer parameter controlling how often progress should be printed to std::out. If 0 no progress will be printed.</param>
+        /// <param name="result">An integer span with at least length (number of spectra * topN) that the indices of the top n candidates for every spectrum are written to.</param>
+        /// <param name="scores">The bytes of a float span for float (f32) methods or an integer span for integer (i32) methods with at least length (number of spectra * topN) that the score of every returned candidate is written to, or an empty span.</param>
+        /// <param name="intScores">Whether the scores span is an integer (i32) or float (f32) span (bool).</param>
+        /// <returns>An integer indicating if the search was successful, 0 = success, 1 = error.</returns>
+        private static int searchCPUInto(IntPtr index, ReadOnlySpan<int> spectraValues, ReadOnlySpan<int> spectraIdx,
+                                         int topN, float tolerance, bool useGaussianTol,
+                                         int batchSize, CPU_METHODS method, int cores, int verbose,
+                                         Span<int> result, Span<byte> scores, bool intScores)
+        {
+            int sVLength = spectraValues.Length;
+            int sILength = spectraIdx.Length;
+
+            var status = 1;
+
+            try
+            {
+                if (result.Length < sILength * topN || (!scores.IsEmpty && scores.Length < sILength * topN * sizeof(int)))
+                {
+                    throw new ArgumentException("Result and scores spans must contain at least (number of spectra * topN) elements!");
+                }
+
+                if (!scores.IsEmpty && intScores != isIntMethod(method))
+                {
+                    throw new ArgumentException("Precision of the scores array does not match the precision of the search method!");
+                }
+
+                ref int sValuesRef = ref MemoryMarshal.GetReference(spectraValues);
+                ref int sIdxRef = ref MemoryMarshal.GetReference(spectraIdx);
+                ref int resultRef = ref MemoryMarshal.GetReference(result);
+                ref byte scoresRef = ref (scores.IsEmpty ? ref Unsafe.NullRef<byte>() : ref MemoryMarshal.GetReference(scores));
+
+                searchCandidateIndexInto(index, ref sValuesRef, ref sIdxRef,
+                                         sVLength, sILength,
+                                         topN, tolerance, useGaussianTol,
+                                         (int) method, batchSize,
+                                         cores, verbose,
+                                         ref resultRef, ref scoresRef);
+
+                status = 0;
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                status = 1;
+            }
+
+            return status;
+        }
+
+        /// <summary>
+        /// Saves a candidate index to a binary index file that can be loaded with loadIndex().
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <param name="path">Path of the index file, an existing file will be overwritten.</param>
+        /// <returns>An integer indicating if the index was successfully saved, 0 = success, 1 = error.</returns>
+        public static int saveIndex(IntPtr index, string path)
+        {
+            var status = 1;
+
+            try
+            {
+                status = saveCandidateIndex(index, path);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                status = 1;
+            }
+
+            return status;
+        }
+
+        /// <summary>
+        /// Loads a candidate index from a binary index file created with saveIndex(). The file is memory mapped instead of read,
+        /// so loading is almost instant and the file is shared between all processes that load it.
+        /// </summary>
+        /// <param name="path">Path of the index file.</param>
+        /// <returns>A pointer to the candidate index or IntPtr.Zero if the index could not be loaded. The index has to be released with releaseIndex().</returns>
+        public static IntPtr loadIndex(string path)
+        {
+            var index = IntPtr.Zero;
+
+            try
+            {
+                index = loadCandidateIndex(path);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                index = IntPtr.Zero;
+            }
+
+            return index;
+        }
+
+        /// <summary>
+        /// Releases a candidate index created with createIndex(), createIndexFromCSR() or loadIndex(). The arrays adopted by createIndexFromCSR() are unpinned.
+        /// </summary>
+        /// <param name="index">A pointer to the candidate index created with createIndex() or loadIndex().</param>
+        /// <returns>An integer indicating if memory was successfully freed, 0 = success, 1 = error.</returns>
+        public static int releaseIndex(IntPtr index)
+        {
+            var memStat = 1;
+
+            try
+            {
+                memStat = releaseCandidateIndex(index);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                memStat = 1;
+            }
+
+            if (memStat == 0)
+            {
+                lock (adoptedArrays)
+                {
+                    if (adoptedArrays.Remove(index, out var handles))
+                    {
+                        foreach (var handle in handles) { handle.Free(); }
+                    }
+                }
+            }
+
+            return memStat;
+        }
+
+        #endregion
+
+        #region CPU_threads
+
+        /// <summary>
+        /// Recreates the native thread pool that runs all CPU methods. Without calling this a pool with one thread per hardware thread is created
+        /// when the first CPU method is called. The cores parameter of every CPU method limits how many threads of the pool a single call uses,
+        /// so concurrent calls with different core counts do not interfere with each other. Must not be called while a CPU method is running.
+        /// </summary>
+        /// <param name="threads">The number of threads (int) of the pool including the calling thread, 0 uses one thread per hardware thread.</param>
+        /// <param name="pinThreads">Whether or not every worker thread should be pinned to its own CPU (bool), not supported on macOS.</param>
+        /// <returns>An integer indicating if the pool was created and all threads were pinned successfully, 0 = success, 1 = error.</returns>
+        public static int configureThreads(int threads, bool pinThreads)
+        {
+            var status = 1;
+
+            try
+            {
+                status = configureThreadPool(threads, pinThreads);
+            }
+            catch (Exception ex)
+            {
+                Console.WriteLine("Something went wrong:");
+                Console.WriteLine(ex.ToString());
+                status = 1;
+            }
+
+            return status;
+        }
+
         #endregion
 
         #region GPU_search